@@ -4,12 +4,52 @@
 #include <string>
 #include <list>
 #include <iterator>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <algorithm>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 template<class K, class V>
 class Multimap{
 
-	std::vector<K> keys;
-	std::vector<V> values;
+	/*
+	Every key-value pair lives in one slot of entries. Slots are threaded onto two intrusive
+	lists by index: one through all live entries in order of insertion (prev/next) and one
+	through the entries that share a key (nextSame). Removed slots are recycled through freeSlots.
+	*/
+	struct Entry{
+		K key;
+		V value;
+		int prev;
+		int next;
+		int nextSame;
+	};
+
+	//First and last slot of the chain of entries for one key, plus its length
+	struct Bucket{
+		int head;
+		int tail;
+		int count;
+	};
+
+	std::vector<Entry> entries;
+	std::vector<int> freeSlots;
+	std::unordered_map<K, Bucket> index;
+
+	//Oldest and newest live entries (-1 when empty)
+	int first = -1;
+	int last = -1;
+
+	//Takes slot out of the insertion order list and hands it back to freeSlots
+	void unlink(int slot);
 
 	public:
 	//Multimap();
@@ -52,6 +92,29 @@ class Multimap{
 	*/
 	int remove(const K& key);
 
+	/*
+	Inserts count key-value pairs read from a contiguous array. Storage for the whole batch is
+	reserved up front instead of growing one pair at a time.
+
+	@return true if the operation is successfull, false if not
+	@param pairs - the first of the key-value pairs to be inserted
+	@param count - the number of pairs
+	*/
+	bool insert_bulk(const std::pair<K, V>* pairs, size_t count);
+
+	/*
+	Looks up count keys at once. The values are written into the caller's results buffer (which is
+	cleared first, so its capacity is reused across calls) grouped by key: the values of keys[i] are
+	results[offsets[i]] up to results[offsets[i+1]], in the same order find(key, list) returns them.
+
+	@return the number of keys that exist in the multimap
+	@param keys - the first of the keys to be searched for
+	@param count - the number of keys
+	@param results - where the associated values will be placed
+	@param offsets - where the count+1 offsets into results will be placed
+	*/
+	size_t find_bulk(const K* keys, size_t count, std::vector<V>& results, std::vector<size_t>& offsets);
+
 	//Print each key in the multimap on a new line (in order of insertion)
 	void printKeys();
 	//Print each value in the multimap on a new line (in order of insertion)
@@ -60,76 +123,578 @@ class Multimap{
 
 template <class K, class V>
 void Multimap<K, V>::printKeys(){
-	for(typename std::vector<K>::iterator it = this->keys.begin(); it != this->keys.end(); it = std::next(it, 1)){
-		std::cout << *it << std::endl;
+	for(int slot = this->first; slot != -1; slot = this->entries[slot].next){
+		std::cout << this->entries[slot].key << std::endl;
 	}
 }
 template <class K, class V>
 void Multimap<K, V>::printValues(){
-	for(typename std::vector<K>::iterator it = this->values.begin(); it != this->values.end(); it = std::next(it, 1)){
-		std::cout << *it << std::endl;
+	for(int slot = this->first; slot != -1; slot = this->entries[slot].next){
+		std::cout << this->entries[slot].value << std::endl;
 	}
 }
 
+template <class K, class V>
+void Multimap<K, V>::unlink(int slot){
+	Entry& entry = this->entries[slot];
+	if(entry.prev != -1)this->entries[entry.prev].next = entry.next;
+	else this->first = entry.next;
+	if(entry.next != -1)this->entries[entry.next].prev = entry.prev;
+	else this->last = entry.prev;
+	this->freeSlots.push_back(slot);
+}
+
 template <class K, class V>
 bool Multimap<K, V>::insert(const K& key, const V& value){
-	this->keys.push_back(key);
-	this->values.push_back(value);
+	Entry entry = {key, value, this->last, -1, -1};
+	int slot;
+	if(this->freeSlots.empty()){
+		slot = this->entries.size();
+		this->entries.push_back(entry);
+	}
+	else{
+		slot = this->freeSlots.back();
+		this->freeSlots.pop_back();
+		this->entries[slot] = entry;
+	}
+
+	//Append to the insertion order list
+	if(this->last != -1)this->entries[this->last].next = slot;
+	else this->first = slot;
+	this->last = slot;
+
+	//Append to the chain for this key so duplicates stay in insertion order
+	typename std::unordered_map<K, Bucket>::iterator it = this->index.find(key);
+	if(it == this->index.end()){
+		Bucket bucket = {slot, slot, 1};
+		this->index.insert(std::make_pair(key, bucket));
+	}
+	else{
+		this->entries[it->second.tail].nextSame = slot;
+		it->second.tail = slot;
+		it->second.count++;
+	}
 	return true;
 }
 
 template <class K, class V>
 bool Multimap<K, V>::find(const K& key){
-	if(this->keys.empty() || this->values.empty())return false;
-	for(typename std::vector<K>::iterator it = this->keys.begin(); it != this->keys.end(); it = std::next(it, 1)){
-		if(*it == key)return true;
-	}
-	return false;
+	return this->index.find(key) != this->index.end();
 }
 
 template <class K, class V>
 bool Multimap<K, V>::find(const K& key, std::list<V>& returnVals){
-	if(this->keys.empty() || this->values.empty())return 0;
-	bool result = false;
-	for(typename std::vector<K>::iterator it = this->keys.begin(); it != this->keys.end(); it = std::next(it, 1)){
-		if(*it == key){
-			result = true;
-			returnVals.push_back(*it);
-		}
+	returnVals.clear();
+	typename std::unordered_map<K, Bucket>::iterator it = this->index.find(key);
+	if(it == this->index.end())return false;
+	for(int slot = it->second.head; slot != -1; slot = this->entries[slot].nextSame){
+		returnVals.push_back(this->entries[slot].value);
 	}
-	return result;
+	return true;
 }
 
 template <class K, class V>
 int Multimap<K,V>::remove(const K& key){
-	if(this->keys.empty() || this->values.empty())return 0;
+	typename std::unordered_map<K, Bucket>::iterator it = this->index.find(key);
+	if(it == this->index.end())return 0;
+	int result = it->second.count;
+	int slot = it->second.head;
+	while(slot != -1){
+		int nextSlot = this->entries[slot].nextSame;
+		this->unlink(slot);
+		slot = nextSlot;
+	}
+	this->index.erase(it);
+	return result;
+}
+
+template <class K, class V>
+bool Multimap<K, V>::insert_bulk(const std::pair<K, V>* pairs, size_t count){
+	size_t fresh = count > this->freeSlots.size() ? count - this->freeSlots.size() : 0;
+	this->entries.reserve(this->entries.size() + fresh);
+	this->index.reserve(this->index.size() + count);
+	for(size_t i = 0; i < count; i++){
+		this->insert(pairs[i].first, pairs[i].second);
+	}
+	return true;
+}
+
+template <class K, class V>
+size_t Multimap<K, V>::find_bulk(const K* keys, size_t count, std::vector<V>& results, std::vector<size_t>& offsets){
+	results.clear();
+	offsets.resize(count + 1);
+	size_t found = 0;
+	for(size_t i = 0; i < count; i++){
+		offsets[i] = results.size();
+		typename std::unordered_map<K, Bucket>::iterator it = this->index.find(keys[i]);
+		if(it == this->index.end())continue;
+		found++;
+		for(int slot = it->second.head; slot != -1; slot = this->entries[slot].nextSame){
+			results.push_back(this->entries[slot].value);
+		}
+	}
+	offsets[count] = results.size();
+	return found;
+}
+
+/*
+Control bytes for FlatMultimap. Every slot has one byte: EMPTY, DELETED (a tombstone left by
+remove), or the low 7 bits of the key's hash when the slot is full. The probe loads a whole
+group of control bytes and compares them against the hash in a single instruction, so most
+slots with a different key are skipped without ever touching the key array.
+*/
+namespace FlatGroup{
+	enum : int8_t { EMPTY = -128, DELETED = -2 };
+
+#if defined(__AVX2__)
+	typedef uint32_t Mask;
+	const size_t WIDTH = 32;
+
+	//Bitmask of the slots in the group whose control byte equals h2
+	inline Mask match(const int8_t* group, int8_t h2){
+		__m256i ctrl = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(group));
+		return static_cast<Mask>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(ctrl, _mm256_set1_epi8(h2))));
+	}
+	//Bitmask of the EMPTY slots in the group
+	inline Mask matchEmpty(const int8_t* group){
+		return match(group, EMPTY);
+	}
+	//Bitmask of the EMPTY or DELETED slots in the group (the only control bytes with the sign bit set)
+	inline Mask matchFree(const int8_t* group){
+		__m256i ctrl = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(group));
+		return static_cast<Mask>(_mm256_movemask_epi8(ctrl));
+	}
+#elif defined(__SSE2__)
+	typedef uint32_t Mask;
+	const size_t WIDTH = 16;
+
+	inline Mask match(const int8_t* group, int8_t h2){
+		__m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+		return static_cast<Mask>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(h2))));
+	}
+	inline Mask matchEmpty(const int8_t* group){
+		return match(group, EMPTY);
+	}
+	inline Mask matchFree(const int8_t* group){
+		__m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+		return static_cast<Mask>(_mm_movemask_epi8(ctrl));
+	}
+#else
+	//Portable fallback: one byte at a time over a group of 8
+	typedef uint32_t Mask;
+	const size_t WIDTH = 8;
+
+	inline Mask match(const int8_t* group, int8_t h2){
+		Mask mask = 0;
+		for(size_t i = 0; i < WIDTH; i++){
+			if(group[i] == h2)mask |= Mask(1) << i;
+		}
+		return mask;
+	}
+	inline Mask matchEmpty(const int8_t* group){
+		return match(group, EMPTY);
+	}
+	inline Mask matchFree(const int8_t* group){
+		Mask mask = 0;
+		for(size_t i = 0; i < WIDTH; i++){
+			if(group[i] < 0)mask |= Mask(1) << i;
+		}
+		return mask;
+	}
+#endif
+}
+
+/*
+An open-addressing multimap for trivially copyable keys. All storage is one contiguous block laid
+out as arrays: the control bytes, then the keys, then the values. Duplicate keys each take their
+own slot. Unlike Multimap, iteration order is slot order, not insertion order.
+*/
+template<class K, class V>
+class FlatMultimap{
+	static_assert(std::is_trivially_copyable<K>::value, "FlatMultimap keys must be trivially copyable");
+
+	//Start of the single allocation; ctrl points at its beginning
+	void* storage = nullptr;
+	int8_t* ctrl = nullptr;
+	K* keys = nullptr;
+	V* values = nullptr;
+
+	//Number of slots (a power of two and a multiple of FlatGroup::WIDTH)
+	size_t capacity = 0;
+	//Number of full slots and DELETED slots
+	size_t count = 0;
+	size_t tombstones = 0;
+
+	//Number of keys hashed and prefetched together by the bulk operations
+	static const size_t FLAT_BATCH = 16;
+
+	//Mixes the bits of std::hash so the identity hash of integers still spreads over both halves
+	static uint64_t hash(const K& key);
+
+	//Allocates room for newCapacity slots and moves every live pair into it
+	void rehash(size_t newCapacity);
+
+	//Returns the first free slot in the probe sequence of hash h (the table must have one)
+	size_t findFree(uint64_t h);
+
+	//Stores the pair in the first free slot for hash h without checking the load factor
+	void place(uint64_t h, const K& key, const V& value);
+
+	//Start of the first group in the probe sequence of hash h
+	const int8_t* firstGroup(uint64_t h) const;
+
+	//Destroys every stored value and releases the allocation
+	void release();
+
+	public:
+	FlatMultimap(){}
+	FlatMultimap(FlatMultimap&& other);
+	FlatMultimap(const FlatMultimap&) = delete;
+	FlatMultimap& operator=(const FlatMultimap&) = delete;
+	~FlatMultimap();
+
+	/*
+	Will add the key-value pair to the multimap. As duplication of keys is allowed, there
+	is no need to check if the key already exists in the multimap.
+
+	@return true if the operation is successfull, false if not
+	@param key, value - the values to be inserted into the multimap
+	*/
+	bool insert(const K& key, const V& value);
+
+	/*
+	Will return true if the key exists in the multimap. Will return false if not.
+
+	@return true if key is in the multimap, false if not
+	@param key - the search value to be compared to
+	*/
+	bool find(const K& key);
+
+	/*
+	Will return true if the key exists in the multimap and false if not. Anytime the key is
+	encountered, the associated value pair will be added to the list parameter. The values will
+	overwrite whatever is in the list not be appended.
+
+	@return true if the key exists in the multimap
+	@param key - the search value
+	@param returnVals - where any associated values will be placed
+	*/
+	bool find(const K& key, std::list<V>& returnVals);
+
+	/*
+	Will go through the multimap and remove and key-value pairs with the key as the parameter. The
+	function will return the number of key-value pairs removed.
+
+	@return the number of key-value pairs removed
+	@param key - the value to be removed from the multimap
+	*/
+	int remove(const K& key);
+
+	/*
+	Inserts count key-value pairs read from a contiguous array. Storage for the whole batch is
+	reserved up front instead of growing one pair at a time.
+
+	@return true if the operation is successfull, false if not
+	@param pairs - the first of the key-value pairs to be inserted
+	@param count - the number of pairs
+	*/
+	bool insert_bulk(const std::pair<K, V>* pairs, size_t count);
+
+	/*
+	Looks up count keys at once. The values are written into the caller's results buffer (which is
+	cleared first, so its capacity is reused across calls) grouped by key: the values of keys[i] are
+	results[offsets[i]] up to results[offsets[i+1]], in the same order find(key, list) returns them.
+
+	@return the number of keys that exist in the multimap
+	@param keys - the first of the keys to be searched for
+	@param count - the number of keys
+	@param results - where the associated values will be placed
+	@param offsets - where the count+1 offsets into results will be placed
+	*/
+	size_t find_bulk(const K* keys, size_t count, std::vector<V>& results, std::vector<size_t>& offsets);
+
+	//Print each key in the multimap on a new line (in slot order)
+	void printKeys();
+	//Print each value in the multimap on a new line (in slot order)
+	void printValues();
+};
+
+template <class K, class V>
+FlatMultimap<K, V>::FlatMultimap(FlatMultimap&& other)
+	: storage(other.storage), ctrl(other.ctrl), keys(other.keys), values(other.values),
+	  capacity(other.capacity), count(other.count), tombstones(other.tombstones){
+	other.storage = nullptr;
+	other.ctrl = nullptr;
+	other.keys = nullptr;
+	other.values = nullptr;
+	other.capacity = 0;
+	other.count = 0;
+	other.tombstones = 0;
+}
+
+template <class K, class V>
+FlatMultimap<K, V>::~FlatMultimap(){
+	this->release();
+}
+
+template <class K, class V>
+void FlatMultimap<K, V>::release(){
+	for(size_t i = 0; i < this->capacity; i++){
+		if(this->ctrl[i] >= 0)this->values[i].~V();
+	}
+	::operator delete(this->storage);
+	this->storage = nullptr;
+}
+
+template <class K, class V>
+uint64_t FlatMultimap<K, V>::hash(const K& key){
+	uint64_t h = std::hash<K>()(key);
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+template <class K, class V>
+void FlatMultimap<K, V>::rehash(size_t newCapacity){
+	//Lay out control bytes, keys and values back to back, each array aligned for its type
+	size_t keyOffset = (newCapacity + alignof(K) - 1) / alignof(K) * alignof(K);
+	size_t valueOffset = keyOffset + newCapacity * sizeof(K);
+	valueOffset = (valueOffset + alignof(V) - 1) / alignof(V) * alignof(V);
+	size_t bytes = valueOffset + newCapacity * sizeof(V);
+
+	void* oldStorage = this->storage;
+	int8_t* oldCtrl = this->ctrl;
+	K* oldKeys = this->keys;
+	V* oldValues = this->values;
+	size_t oldCapacity = this->capacity;
+
+	this->storage = ::operator new(bytes);
+	char* base = static_cast<char*>(this->storage);
+	this->ctrl = reinterpret_cast<int8_t*>(base);
+	this->keys = reinterpret_cast<K*>(base + keyOffset);
+	this->values = reinterpret_cast<V*>(base + valueOffset);
+	this->capacity = newCapacity;
+	this->tombstones = 0;
+	std::memset(this->ctrl, FlatGroup::EMPTY, newCapacity);
+
+	for(size_t i = 0; i < oldCapacity; i++){
+		if(oldCtrl[i] < 0)continue;
+		uint64_t h = FlatMultimap<K, V>::hash(oldKeys[i]);
+		size_t slot = this->findFree(h);
+		this->ctrl[slot] = static_cast<int8_t>(h & 0x7F);
+		this->keys[slot] = oldKeys[i];
+		new (&this->values[slot]) V(std::move(oldValues[i]));
+		oldValues[i].~V();
+	}
+	::operator delete(oldStorage);
+}
+
+template <class K, class V>
+size_t FlatMultimap<K, V>::findFree(uint64_t h){
+	size_t groupMask = this->capacity / FlatGroup::WIDTH - 1;
+	size_t group = (h >> 7) & groupMask;
+	//Triangular probing over whole groups visits every group once when the count is a power of two
+	for(size_t step = 1; ; step++){
+		size_t base = group * FlatGroup::WIDTH;
+		FlatGroup::Mask free = FlatGroup::matchFree(this->ctrl + base);
+		if(free)return base + __builtin_ctz(free);
+		group = (group + step) & groupMask;
+	}
+}
+
+template <class K, class V>
+void FlatMultimap<K, V>::place(uint64_t h, const K& key, const V& value){
+	size_t slot = this->findFree(h);
+	if(this->ctrl[slot] == FlatGroup::DELETED)this->tombstones--;
+	this->ctrl[slot] = static_cast<int8_t>(h & 0x7F);
+	this->keys[slot] = key;
+	new (&this->values[slot]) V(value);
+	this->count++;
+}
+
+template <class K, class V>
+const int8_t* FlatMultimap<K, V>::firstGroup(uint64_t h) const{
+	size_t groupMask = this->capacity / FlatGroup::WIDTH - 1;
+	return this->ctrl + ((h >> 7) & groupMask) * FlatGroup::WIDTH;
+}
+
+template <class K, class V>
+bool FlatMultimap<K, V>::insert(const K& key, const V& value){
+	//Keep full and deleted slots under 7/8 of the table so probes always end at an EMPTY byte
+	if((this->count + this->tombstones + 1) * 8 > this->capacity * 7){
+		size_t newCapacity = this->capacity ? this->capacity : FlatGroup::WIDTH;
+		//Only grow when live entries need it; otherwise rehashing in place clears the tombstones
+		if((this->count + 1) * 16 > newCapacity * 7)newCapacity *= 2;
+		this->rehash(newCapacity);
+	}
+	this->place(FlatMultimap<K, V>::hash(key), key, value);
+	return true;
+}
+
+template <class K, class V>
+bool FlatMultimap<K, V>::insert_bulk(const std::pair<K, V>* pairs, size_t count){
+	//Size the table for the whole batch with a single rehash
+	if((this->count + this->tombstones + count) * 8 > this->capacity * 7){
+		size_t newCapacity = this->capacity ? this->capacity : FlatGroup::WIDTH;
+		while((this->count + count) * 8 > newCapacity * 7)newCapacity *= 2;
+		this->rehash(newCapacity);
+	}
+	//Hash a block of keys and prefetch their first groups before placing any of them
+	uint64_t hashes[FLAT_BATCH];
+	for(size_t begin = 0; begin < count; begin += FLAT_BATCH){
+		size_t end = std::min(count, begin + FLAT_BATCH);
+		for(size_t i = begin; i < end; i++){
+			hashes[i - begin] = FlatMultimap<K, V>::hash(pairs[i].first);
+			__builtin_prefetch(this->firstGroup(hashes[i - begin]), 1);
+		}
+		for(size_t i = begin; i < end; i++){
+			this->place(hashes[i - begin], pairs[i].first, pairs[i].second);
+		}
+	}
+	return true;
+}
+
+template <class K, class V>
+bool FlatMultimap<K, V>::find(const K& key){
+	if(this->count == 0)return false;
+	uint64_t h = FlatMultimap<K, V>::hash(key);
+	int8_t h2 = static_cast<int8_t>(h & 0x7F);
+	size_t groupMask = this->capacity / FlatGroup::WIDTH - 1;
+	size_t group = (h >> 7) & groupMask;
+	for(size_t step = 1; ; step++){
+		size_t base = group * FlatGroup::WIDTH;
+		for(FlatGroup::Mask m = FlatGroup::match(this->ctrl + base, h2); m; m &= m - 1){
+			if(this->keys[base + __builtin_ctz(m)] == key)return true;
+		}
+		if(FlatGroup::matchEmpty(this->ctrl + base))return false;
+		group = (group + step) & groupMask;
+	}
+}
+
+template <class K, class V>
+bool FlatMultimap<K, V>::find(const K& key, std::list<V>& returnVals){
+	returnVals.clear();
+	if(this->count == 0)return false;
+	uint64_t h = FlatMultimap<K, V>::hash(key);
+	int8_t h2 = static_cast<int8_t>(h & 0x7F);
+	size_t groupMask = this->capacity / FlatGroup::WIDTH - 1;
+	size_t group = (h >> 7) & groupMask;
+	//Duplicates can be spread over several groups, so keep going until a group with an EMPTY slot
+	for(size_t step = 1; ; step++){
+		size_t base = group * FlatGroup::WIDTH;
+		for(FlatGroup::Mask m = FlatGroup::match(this->ctrl + base, h2); m; m &= m - 1){
+			size_t slot = base + __builtin_ctz(m);
+			if(this->keys[slot] == key)returnVals.push_back(this->values[slot]);
+		}
+		if(FlatGroup::matchEmpty(this->ctrl + base))break;
+		group = (group + step) & groupMask;
+	}
+	return !returnVals.empty();
+}
+
+template <class K, class V>
+int FlatMultimap<K, V>::remove(const K& key){
+	if(this->count == 0)return 0;
 	int result = 0;
-	typename std::vector<V>::iterator vIt = this->values.begin();
-	typename std::vector<K>::iterator it = this->keys.begin();
-	while(it != this->keys.end()){
-		if(*it == key){
+	uint64_t h = FlatMultimap<K, V>::hash(key);
+	int8_t h2 = static_cast<int8_t>(h & 0x7F);
+	size_t groupMask = this->capacity / FlatGroup::WIDTH - 1;
+	size_t group = (h >> 7) & groupMask;
+	for(size_t step = 1; ; step++){
+		size_t base = group * FlatGroup::WIDTH;
+		//A group that already has an EMPTY slot ends every probe through it, so its freed slots can go back to EMPTY
+		bool hasEmpty = FlatGroup::matchEmpty(this->ctrl + base) != 0;
+		for(FlatGroup::Mask m = FlatGroup::match(this->ctrl + base, h2); m; m &= m - 1){
+			size_t slot = base + __builtin_ctz(m);
+			if(!(this->keys[slot] == key))continue;
+			this->values[slot].~V();
+			if(hasEmpty){
+				this->ctrl[slot] = FlatGroup::EMPTY;
+			}
+			else{
+				this->ctrl[slot] = FlatGroup::DELETED;
+				this->tombstones++;
+			}
+			this->count--;
 			result++;
-			this->values.erase(vIt);
-			this->keys.erase(it);
-		}
-		else{
-			it = std::next(it, 1);
-			vIt = std::next(vIt, 1);
 		}
+		if(hasEmpty)break;
+		group = (group + step) & groupMask;
 	}
 	return result;
 }
 
-int main(){
-	std::uniform_int_distribution<int> range(0,200);
-	std::default_random_engine generator;
+template <class K, class V>
+size_t FlatMultimap<K, V>::find_bulk(const K* keys, size_t count, std::vector<V>& results, std::vector<size_t>& offsets){
+	results.clear();
+	offsets.resize(count + 1);
+	size_t found = 0;
+	if(this->count == 0){
+		std::fill(offsets.begin(), offsets.end(), 0);
+		return 0;
+	}
+	size_t groupMask = this->capacity / FlatGroup::WIDTH - 1;
+	//Hash a block of keys and prefetch the control bytes and keys of their first groups, so the
+	//cache misses for the whole block overlap instead of being paid one lookup at a time
+	uint64_t hashes[FLAT_BATCH];
+	for(size_t begin = 0; begin < count; begin += FLAT_BATCH){
+		size_t end = std::min(count, begin + FLAT_BATCH);
+		for(size_t i = begin; i < end; i++){
+			uint64_t h = FlatMultimap<K, V>::hash(keys[i]);
+			hashes[i - begin] = h;
+			const int8_t* group = this->firstGroup(h);
+			__builtin_prefetch(group);
+			__builtin_prefetch(this->keys + (group - this->ctrl));
+		}
+		for(size_t i = begin; i < end; i++){
+			offsets[i] = results.size();
+			uint64_t h = hashes[i - begin];
+			int8_t h2 = static_cast<int8_t>(h & 0x7F);
+			size_t group = (h >> 7) & groupMask;
+			for(size_t step = 1; ; step++){
+				size_t base = group * FlatGroup::WIDTH;
+				for(FlatGroup::Mask m = FlatGroup::match(this->ctrl + base, h2); m; m &= m - 1){
+					size_t slot = base + __builtin_ctz(m);
+					if(this->keys[slot] == keys[i])results.push_back(this->values[slot]);
+				}
+				if(FlatGroup::matchEmpty(this->ctrl + base))break;
+				group = (group + step) & groupMask;
+			}
+			if(results.size() != offsets[i])found++;
+		}
+	}
+	offsets[count] = results.size();
+	return found;
+}
 
+template <class K, class V>
+void FlatMultimap<K, V>::printKeys(){
+	for(size_t i = 0; i < this->capacity; i++){
+		if(this->ctrl[i] >= 0)std::cout << this->keys[i] << std::endl;
+	}
+}
+template <class K, class V>
+void FlatMultimap<K, V>::printValues(){
+	for(size_t i = 0; i < this->capacity; i++){
+		if(this->ctrl[i] >= 0)std::cout << this->values[i] << std::endl;
+	}
+}
+
+/*
+Fills a fresh map of type Map with 100 random key-value pairs and then removes every key again,
+printing whether every key was found and every pair was removed. Repeated 10 times.
+*/
+template<class Map>
+void randomTest(std::default_random_engine& generator, std::uniform_int_distribution<int>& range){
 	//loop to repeat the test 10 times
 	for(int i = 0; i<10; i++){
 		bool testPassed = true;
 		std::list<int> testKeys;
 		std::list<int> testVals;
-		Multimap<int, int> testMap = Multimap<int, int>();
+		Map testMap = Map();
 		//loop that populates multimap and lists with test values
 		for(int j = 0; j < 100; j++){
 			testKeys.push_back(range(generator));
@@ -154,5 +719,52 @@ int main(){
 		testKeys.clear();
 		testVals.clear();
 	}
-	return 0;
 }
+
+/*
+Loads 1000 random pairs with insert_bulk and checks that find_bulk returns, for every key, the
+same values as find(key, list). Prints whether the two agreed.
+*/
+template<class Map>
+void bulkTest(std::default_random_engine& generator, std::uniform_int_distribution<int>& range){
+	Map testMap = Map();
+	std::vector< std::pair<int, int> > pairs;
+	std::vector<int> keys;
+	for(int j = 0; j < 1000; j++){
+		pairs.push_back(std::make_pair(range(generator), range(generator)));
+		keys.push_back(range(generator));
+	}
+	testMap.insert_bulk(pairs.data(), pairs.size());
+
+	std::vector<int> results;
+	std::vector<size_t> offsets;
+	size_t found = testMap.find_bulk(keys.data(), keys.size(), results, offsets);
+
+	bool testPassed = true;
+	size_t expectedFound = 0;
+	for(size_t j = 0; j < keys.size(); j++){
+		std::list<int> single;
+		if(testMap.find(keys[j], single))expectedFound++;
+		std::list<int> bulk(results.begin() + offsets[j], results.begin() + offsets[j+1]);
+		single.sort();
+		bulk.sort();
+		if(single != bulk)testPassed = false;
+	}
+	if(testPassed && found == expectedFound){
+		std::cout << "Bulk Test Passed: True" << std::endl;
+	}
+	else{
+		std::cout << "Bulk Test Passed: False" << std::endl;
+	}
+}
+
+int main(){
+	std::uniform_int_distribution<int> range(0,200);
+	std::default_random_engine generator;
+
+	randomTest< Multimap<int, int> >(generator, range);
+	randomTest< FlatMultimap<int, int> >(generator, range);
+	bulkTest< Multimap<int, int> >(generator, range);
+	bulkTest< FlatMultimap<int, int> >(generator, range);
+	return 0;
+}
\ No newline at end of file
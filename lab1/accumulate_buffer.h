@@ -0,0 +1,89 @@
+#ifndef ACCUMULATE_BUFFER_H_
+#define ACCUMULATE_BUFFER_H_
+#include <unordered_map>
+#include <cstddef>
+
+/*
+A private, single-threaded front for a shared store's accumulate. Each thread owns its own buffer
+and accumulates into a local hash map; the local sums are merged into the store with one call to
+Store::accumulateBatch once threshold distinct keys are pending, on flush(), or when the buffer is
+destroyed. Values added here are not visible through the store until they are flushed, but once
+every buffer is flushed the store holds exactly the sums it would have had without buffering.
+*/
+template<class Store, class K, class V>
+class AccumulateBuffer{
+	Store& store;
+	std::unordered_map<K, V> pending;
+	size_t threshold;
+
+	public:
+	/*
+	Creates an empty buffer in front of store.
+
+	@param target: the shared store the sums are merged into
+	@param maxPending: the number of distinct pending keys that triggers a flush
+	*/
+	AccumulateBuffer(Store& target, size_t maxPending);
+
+	//Flushes anything still pending
+	~AccumulateBuffer();
+
+	AccumulateBuffer(const AccumulateBuffer&) = delete;
+	AccumulateBuffer& operator=(const AccumulateBuffer&) = delete;
+
+	/*
+	Adds value to the pending sum for key, flushing if that makes threshold keys pending.
+
+	@param key, value: the key-value pair to be accumulated
+	@return true when the key-value pair is buffered (or flushed)
+	*/
+	bool accumulate(const K& key, const V& value);
+
+	/*
+	Returns true if key has a sum waiting to be flushed and stores that pending sum in value.
+
+	@param key: key to be searched for
+	@param value: where the pending sum is stored
+	@return true if the key is pending and false if not
+	*/
+	bool lookupPending(const K& key, V& value) const;
+
+	//Merges every pending sum into the store and empties the buffer
+	void flush();
+};
+
+template<class Store, class K, class V>
+AccumulateBuffer<Store, K, V>::AccumulateBuffer(Store& target, size_t maxPending)
+	: store(target), threshold(maxPending ? maxPending : 1){
+	pending.reserve(threshold);
+}
+
+template<class Store, class K, class V>
+AccumulateBuffer<Store, K, V>::~AccumulateBuffer(){
+	flush();
+}
+
+template<class Store, class K, class V>
+bool AccumulateBuffer<Store, K, V>::accumulate(const K& key, const V& value){
+	auto inserted = pending.insert({key, value});
+	if(!inserted.second)inserted.first->second = inserted.first->second + value;
+	if(pending.size() >= threshold)flush();
+	return true;
+}
+
+template<class Store, class K, class V>
+bool AccumulateBuffer<Store, K, V>::lookupPending(const K& key, V& value) const{
+	auto val = pending.find(key);
+	if(val == pending.end())return false;
+	value = val->second;
+	return true;
+}
+
+template<class Store, class K, class V>
+void AccumulateBuffer<Store, K, V>::flush(){
+	if(pending.empty())return;
+	store.accumulateBatch(pending);
+	pending.clear();
+}
+
+#endif
@@ -0,0 +1,452 @@
+#ifndef SHARDED_KV_STORE_H_
+#define SHARDED_KV_STORE_H_
+#include <unordered_map>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+#include <pthread.h>
+#include <atomic>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+#include <vector>
+
+//Shard lock where readers and writers alike take the one mutex
+class ShardMutex{
+	std::mutex mtx;
+	public:
+	void lock(){ mtx.lock(); }
+	void unlock(){ mtx.unlock(); }
+	void lock_shared(){ mtx.lock(); }
+	void unlock_shared(){ mtx.unlock(); }
+};
+
+//Shard lock that lets any number of readers in at once but gives writers the shard to themselves
+class ShardRWLock{
+	pthread_rwlock_t rwLock;
+	public:
+	ShardRWLock(){ pthread_rwlock_init(&rwLock, NULL); }
+	~ShardRWLock(){ pthread_rwlock_destroy(&rwLock); }
+	ShardRWLock(const ShardRWLock&) = delete;
+	ShardRWLock& operator=(const ShardRWLock&) = delete;
+	void lock(){ pthread_rwlock_wrlock(&rwLock); }
+	void unlock(){ pthread_rwlock_unlock(&rwLock); }
+	void lock_shared(){ pthread_rwlock_rdlock(&rwLock); }
+	void unlock_shared(){ pthread_rwlock_unlock(&rwLock); }
+};
+
+//Holds a shard lock in shared (reader) mode for the lifetime of the guard
+template<class Lock>
+class SharedGuard{
+	Lock& held;
+	public:
+	explicit SharedGuard(Lock& lock) : held(lock){ held.lock_shared(); }
+	~SharedGuard(){ held.unlock_shared(); }
+	SharedGuard(const SharedGuard&) = delete;
+	SharedGuard& operator=(const SharedGuard&) = delete;
+};
+
+/*
+How ShardedKVStore keeps its values. Integral values are stored as std::atomic<V> so that adding
+to a key that already exists only needs the shard's shared lock: concurrent accumulates race on
+the atomic, not on the map. Every other type is stored as is and always updated exclusively.
+*/
+template<class V, bool Atomic = std::is_integral<V>::value>
+struct StoredValue{
+	typedef V type;
+	static V load(const type& slot){ return slot; }
+	static void store(type& slot, const V& value){ slot = value; }
+};
+
+template<class V>
+struct StoredValue<V, true>{
+	typedef std::atomic<V> type;
+	static V load(const type& slot){ return slot.load(std::memory_order_relaxed); }
+	static void store(type& slot, const V& value){ slot.store(value, std::memory_order_relaxed); }
+	static void add(type& slot, const V& value){ slot.fetch_add(value, std::memory_order_relaxed); }
+};
+
+//Index of the shard that owns key among count shards
+template<class K>
+size_t shardIndex(const K& key, size_t count){
+	//Pick the shard from the high bits of a mixed hash, so it does not line up with the buckets
+	//the shard's own map picks from the low bits
+	uint64_t h = std::hash<K>()(key) * 0x9E3779B97F4A7C15ULL;
+	return (h >> 32) % count;
+}
+
+/*
+An immutable, point-in-time view of a store. A snapshot shares the maps the store had when it was
+taken instead of copying them; the store copies a shard's map before its next write to that shard
+(copy-on-write), so the snapshot never changes and can be read without taking any lock.
+*/
+template<class K, class V>
+class KVSnapshot{
+	public:
+	typedef StoredValue<V> Slot;
+	typedef std::unordered_map<K, typename Slot::type> Map;
+
+	/*
+	Creates a snapshot from the maps of every shard, in shard order.
+
+	@param maps: one map per shard
+	*/
+	explicit KVSnapshot(std::vector< std::shared_ptr<const Map> > maps);
+
+	/*
+	Returns true if the key was present when the snapshot was taken. If it was, the value it had
+	then is stored in the value parameter.
+
+	@param key: key to be searched for
+	@param value: where the found value is stored
+	@return true if the value is present and false if not
+	*/
+	bool lookup(const K& key, V& value) const;
+
+	/*
+	Calls visit(key, value) on every pair in the snapshot.
+
+	@param visit: function called with each key and value
+	*/
+	template<class F>
+	void forEach(F visit) const;
+
+	//Returns the number of pairs in the snapshot
+	size_t size() const;
+
+	private:
+	std::vector< std::shared_ptr<const Map> > shards;
+};
+
+template<class K, class V>
+KVSnapshot<K, V>::KVSnapshot(std::vector< std::shared_ptr<const Map> > maps) : shards(std::move(maps)){
+}
+
+template<class K, class V>
+bool KVSnapshot<K, V>::lookup(const K& key, V& value) const{
+	const Map& umap = *shards[shardIndex(key, shards.size())];
+	auto val = umap.find(key);
+	if(val == umap.end())return false;
+	value = Slot::load(val->second);
+	return true;
+}
+
+template<class K, class V>
+template<class F>
+void KVSnapshot<K, V>::forEach(F visit) const{
+	for(size_t i = 0; i < shards.size(); i++){
+		for(auto it = shards[i]->begin(); it != shards[i]->end(); ++it){
+			visit(it->first, Slot::load(it->second));
+		}
+	}
+}
+
+template<class K, class V>
+size_t KVSnapshot<K, V>::size() const{
+	size_t total = 0;
+	for(size_t i = 0; i < shards.size(); i++){
+		total += shards[i]->size();
+	}
+	return total;
+}
+
+/*
+A threadsafe key-value store split into independently locked shards. Each key belongs to exactly
+one shard (picked from its hash), and every shard is its own unordered_map behind its own lock,
+so threads working on keys in different shards never wait on each other. Lock is ShardMutex for
+plain exclusive locking or ShardRWLock to let lookups in the same shard run in parallel. With
+ShardRWLock and an integral V, insert and accumulate on existing keys run in parallel as well.
+*/
+template<class K, class V, class Lock = ShardMutex>
+class ShardedKVStore{
+	typedef StoredValue<V> Slot;
+	typedef std::integral_constant<bool, std::is_integral<V>::value> IsAtomic;
+	typedef typename KVSnapshot<K, V>::Map Map;
+
+	struct Shard{
+		Lock lock;
+		std::shared_ptr<Map> umap;
+		//Set when a snapshot takes umap; the next write copies the map first and clears it
+		bool inSnapshot = false;
+		//Keeps the next shard's lock off the cache line this shard's map header lives on
+		char padding[64];
+	};
+
+	std::unique_ptr<Shard[]> shards;
+	size_t shardCount;
+
+	//Returns the shard that owns key
+	Shard& shardFor(const K& key);
+
+	//Returns the shard's map, copying it first if a snapshot shares it (caller holds the exclusive lock)
+	static Map& writable(Shard& shard);
+
+	//Updates an existing key under the shared lock; only a new key takes the shard exclusively
+	bool insert(const K& key, const V& value, std::true_type);
+	bool accumulate(const K& key, const V& value, std::true_type);
+	//Takes the shard exclusively for every update
+	bool insert(const K& key, const V& value, std::false_type);
+	bool accumulate(const K& key, const V& value, std::false_type);
+
+	//Adds value to key in shard, whose exclusive lock the caller already holds
+	static void addLocked(Shard& shard, const K& key, const V& value, std::true_type);
+	static void addLocked(Shard& shard, const K& key, const V& value, std::false_type);
+
+	public:
+	/*
+	Creates a store with numShards shards. More shards means less contention between threads
+	but a little more memory and a slower full scan.
+
+	@param numShards: the number of independently locked shards (at least 1)
+	*/
+	explicit ShardedKVStore(size_t numShards = 16);
+
+	/*
+	Inserts key-value pair into the hashmap if the the value does not already exist.
+	If the key already exists in the map, the value is changed to the new value. Returns
+	true on successful insertion.
+
+	@param key, value: the key-value pair to be inserted
+	@return true when the key-value pair is inserted/updated
+	*/
+	bool insert(const K& key, const V& value);
+
+	/*
+	Inserts the key-value pair if it does not already exist. If the key is already in the
+	map, the value is added to the current value. Returns true when it adds/updates the value.
+
+	@param key, value: the key-value pair to be inserted
+	@return true when the key-value pair is inserted/updated
+	*/
+	bool accumulate(const K& key, const V& value);
+
+	/*
+	Accumulates every pair in pending into the store, as if accumulate were called on each of them.
+	The pairs are grouped by shard first so that each shard is locked once for the whole batch.
+
+	@param pending: the key-value pairs to be added
+	@return true when every pair is inserted/updated
+	*/
+	bool accumulateBatch(const std::unordered_map<K, V>& pending);
+
+	/*
+	Returns true if the value is present in the map and false if not. If it is present, the
+	associated value is stored in the value parameter.
+
+	@param key: key to be searched for
+	@param value: where the found value is stored
+	@return true if the value is present and false if not
+	*/
+	bool lookup(const K& key, V& value);
+
+	/*
+	Removes the key-value pair from the map if it is present in the map. Does nothing if not.
+	Returns true assuming no errors/exceptions.
+
+	@param key: key element to be removed from the map
+	@return true if there are no exceptions
+	*/
+	bool remove(const K& key);
+
+	/*
+	Returns a consistent view of the whole store that can be read while writers keep going. Every
+	shard is locked only long enough to share its map with the snapshot; the scan itself runs on
+	the snapshot without holding any lock. The first write to each shard afterwards copies that
+	shard's map while the snapshot is alive.
+
+	@return the snapshot
+	*/
+	KVSnapshot<K, V> snapshot();
+
+	/*
+	Calls visit(key, value) on every pair in the store. Only one shard is read-locked at a time, so
+	the pairs seen are only a consistent view of the whole store if no writers are running.
+
+	@param visit: function called with each key and value
+	*/
+	template<class F>
+	void forEach(F visit);
+
+	//Returns the number of shards
+	size_t numShards() const;
+};
+
+template<class K, class V, class Lock>
+ShardedKVStore<K, V, Lock>::ShardedKVStore(size_t numShards)
+	: shards(new Shard[numShards ? numShards : 1]), shardCount(numShards ? numShards : 1){
+	for(size_t i = 0; i < shardCount; i++){
+		shards[i].umap = std::make_shared<Map>();
+	}
+}
+
+template<class K, class V, class Lock>
+typename ShardedKVStore<K, V, Lock>::Shard& ShardedKVStore<K, V, Lock>::shardFor(const K& key){
+	return shards[shardIndex(key, shardCount)];
+}
+
+template<class K, class V, class Lock>
+typename ShardedKVStore<K, V, Lock>::Map& ShardedKVStore<K, V, Lock>::writable(Shard& shard){
+	//The flag is only touched under the shard's locks, so no snapshot reader is ever raced. A map
+	//whose snapshots are all gone already still gets copied once; it just is not needed then.
+	if(shard.inSnapshot){
+		std::shared_ptr<Map> copy = std::make_shared<Map>();
+		copy->reserve(shard.umap->size());
+		for(auto it = shard.umap->begin(); it != shard.umap->end(); ++it){
+			copy->emplace(std::piecewise_construct, std::forward_as_tuple(it->first), std::forward_as_tuple(Slot::load(it->second)));
+		}
+		shard.umap = copy;
+		shard.inSnapshot = false;
+	}
+	return *shard.umap;
+}
+
+template<class K, class V, class Lock>
+bool ShardedKVStore<K, V, Lock>::insert(const K& key, const V& value){
+	return insert(key, value, IsAtomic());
+}
+
+template<class K, class V, class Lock>
+bool ShardedKVStore<K, V, Lock>::accumulate(const K& key, const V& value){
+	return accumulate(key, value, IsAtomic());
+}
+
+template<class K, class V, class Lock>
+bool ShardedKVStore<K, V, Lock>::insert(const K& key, const V& value, std::true_type){
+	Shard& shard = shardFor(key);
+	{
+		SharedGuard<Lock> lock(shard.lock);
+		//Updating in place would change a snapshot that shares the map; that needs the exclusive path
+		if(!shard.inSnapshot){
+			auto val = shard.umap->find(key);
+			if(val != shard.umap->end()){
+				Slot::store(val->second, value);
+				return true;
+			}
+		}
+	}
+	//The key may have been added between the two locks, so look again before emplacing
+	std::lock_guard<Lock> lock(shard.lock);
+	auto inserted = writable(shard).emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(value));
+	if(!inserted.second)Slot::store(inserted.first->second, value);
+	return true;
+}
+
+template<class K, class V, class Lock>
+bool ShardedKVStore<K, V, Lock>::accumulate(const K& key, const V& value, std::true_type){
+	Shard& shard = shardFor(key);
+	{
+		SharedGuard<Lock> lock(shard.lock);
+		//Updating in place would change a snapshot that shares the map; that needs the exclusive path
+		if(!shard.inSnapshot){
+			auto val = shard.umap->find(key);
+			if(val != shard.umap->end()){
+				Slot::add(val->second, value);
+				return true;
+			}
+		}
+	}
+	std::lock_guard<Lock> lock(shard.lock);
+	addLocked(shard, key, value, IsAtomic());
+	return true;
+}
+
+template<class K, class V, class Lock>
+bool ShardedKVStore<K, V, Lock>::insert(const K& key, const V& value, std::false_type){
+	Shard& shard = shardFor(key);
+	std::lock_guard<Lock> lock(shard.lock);
+	writable(shard)[key] = value;
+	return true;
+}
+
+template<class K, class V, class Lock>
+bool ShardedKVStore<K, V, Lock>::accumulate(const K& key, const V& value, std::false_type){
+	Shard& shard = shardFor(key);
+	std::lock_guard<Lock> lock(shard.lock);
+	addLocked(shard, key, value, IsAtomic());
+	return true;
+}
+
+template<class K, class V, class Lock>
+void ShardedKVStore<K, V, Lock>::addLocked(Shard& shard, const K& key, const V& value, std::true_type){
+	auto inserted = writable(shard).emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(value));
+	if(!inserted.second)Slot::add(inserted.first->second, value);
+}
+
+template<class K, class V, class Lock>
+void ShardedKVStore<K, V, Lock>::addLocked(Shard& shard, const K& key, const V& value, std::false_type){
+	auto inserted = writable(shard).insert({key, value});
+	if(!inserted.second)inserted.first->second = inserted.first->second + value;
+}
+
+template<class K, class V, class Lock>
+bool ShardedKVStore<K, V, Lock>::accumulateBatch(const std::unordered_map<K, V>& pending){
+	//Bucket the pairs by shard, then visit each shard that has any under a single lock
+	std::vector< std::vector<const std::pair<const K, V>*> > byShard(shardCount);
+	for(auto it = pending.begin(); it != pending.end(); ++it){
+		byShard[&shardFor(it->first) - shards.get()].push_back(&*it);
+	}
+	for(size_t i = 0; i < shardCount; i++){
+		if(byShard[i].empty())continue;
+		std::lock_guard<Lock> lock(shards[i].lock);
+		for(size_t j = 0; j < byShard[i].size(); j++){
+			addLocked(shards[i], byShard[i][j]->first, byShard[i][j]->second, IsAtomic());
+		}
+	}
+	return true;
+}
+
+template<class K, class V, class Lock>
+bool ShardedKVStore<K, V, Lock>::lookup(const K& key, V& value){
+	Shard& shard = shardFor(key);
+	SharedGuard<Lock> lock(shard.lock);
+	auto val = shard.umap->find(key);
+	if(val == shard.umap->end())return false;
+	value = Slot::load(val->second);
+	return true;
+}
+
+template<class K, class V, class Lock>
+bool ShardedKVStore<K, V, Lock>::remove(const K& key){
+	Shard& shard = shardFor(key);
+	std::lock_guard<Lock> lock(shard.lock);
+	writable(shard).erase(key);
+	return true;
+}
+
+template<class K, class V, class Lock>
+KVSnapshot<K, V> ShardedKVStore<K, V, Lock>::snapshot(){
+	//Hold every shard at once (always in index order) so the snapshot is a single point in time.
+	//The exclusive lock also keeps the shared-lock fast paths from updating a map mid-share.
+	std::vector< std::shared_ptr<const Map> > maps(shardCount);
+	for(size_t i = 0; i < shardCount; i++){
+		shards[i].lock.lock();
+	}
+	for(size_t i = 0; i < shardCount; i++){
+		maps[i] = shards[i].umap;
+		shards[i].inSnapshot = true;
+	}
+	for(size_t i = 0; i < shardCount; i++){
+		shards[i].lock.unlock();
+	}
+	return KVSnapshot<K, V>(std::move(maps));
+}
+
+template<class K, class V, class Lock>
+template<class F>
+void ShardedKVStore<K, V, Lock>::forEach(F visit){
+	for(size_t i = 0; i < shardCount; i++){
+		SharedGuard<Lock> lock(shards[i].lock);
+		for(auto it = shards[i].umap->begin(); it != shards[i].umap->end(); ++it){
+			visit(it->first, Slot::load(it->second));
+		}
+	}
+}
+
+template<class K, class V, class Lock>
+size_t ShardedKVStore<K, V, Lock>::numShards() const{
+	return shardCount;
+}
+
+#endif
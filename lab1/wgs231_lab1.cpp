@@ -7,10 +7,16 @@
 #include <random>
 #include <iterator>
 #include <ctime>
+#include <chrono>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <tuple>
+#include "sharded_kv_store.h"
+#include "accumulate_buffer.h"
 
 //Mutex used to synchronize ThreadSafeKVStore
 std::mutex mMap;
-int reader_count = 0;
 //Mutex and Condition Variables to synchronize ThreadSafeListenerQueue
 std::mutex mList;
 std::condition_variable cv;
@@ -56,6 +62,21 @@ class ThreadSafeKVStore{
 		return true;
 	}
 
+	/*
+	Accumulates every pair in pending into the map while holding the lock once for the whole batch.
+
+	@param pending: the key-value pairs to be added
+	@return true when every pair is inserted/updated
+	*/
+	bool accumulateBatch(const std::unordered_map<K, V>& pending){
+		std::lock_guard<std::mutex> lock(mMap);
+		for(auto it = pending.begin(); it != pending.end(); ++it){
+			auto inserted = umap.insert(*it);
+			if(!inserted.second)inserted.first->second = inserted.first->second + it->second;
+		}
+		return true;
+	}
+
 	/*
 	Returns true if the value is present in the map and false if not. If it is present, the
 	associated value is stored in the value parameter.
@@ -65,9 +86,7 @@ class ThreadSafeKVStore{
 	@return true if the value is present and false if not
 	*/
 	bool lookup(const K key, V& value){
-		if(reader_count += 1){
-			std::lock_guard<std::mutex> lock(mMap);
-		}
+		std::lock_guard<std::mutex> lock(mMap);
 		auto val = umap.find(key);
 		if(val == umap.end())return false;
 		value = val->second;
@@ -87,6 +106,38 @@ class ThreadSafeKVStore{
 		umap.erase(key);
 		return true;
 	}
+	/*
+	Calls visit(key, value) on every pair in the map while holding the map's lock.
+
+	@param visit: function called with each key and value
+	*/
+	template<class F>
+	void forEach(F visit){
+		std::lock_guard<std::mutex> lock(mMap);
+		for(auto it = umap.begin(); it != umap.end(); ++it){
+			visit(it->first, it->second);
+		}
+	}
+
+	/*
+	Returns a copy of the whole map as a snapshot. The map is locked for the copy, but not while
+	the snapshot is read.
+
+	@return the snapshot
+	*/
+	KVSnapshot<K, V> snapshot(){
+		auto copy = std::make_shared<typename KVSnapshot<K, V>::Map>();
+		{
+			std::lock_guard<std::mutex> lock(mMap);
+			copy->reserve(umap.size());
+			for(auto it = umap.begin(); it != umap.end(); ++it){
+				copy->emplace(std::piecewise_construct, std::forward_as_tuple(it->first), std::forward_as_tuple(it->second));
+			}
+		}
+		std::vector< std::shared_ptr<const typename KVSnapshot<K, V>::Map> > maps(1, copy);
+		return KVSnapshot<K, V>(std::move(maps));
+	}
+
 	typename std::unordered_map<K, V>::iterator begin(){
 		return umap.begin();
 	}
@@ -154,8 +205,25 @@ class ThreadSafeListenerQueue{
 	}
 };
 
-void threadTest(ThreadSafeKVStore<std::string, int32_t> *kvStore, ThreadSafeListenerQueue<int32_t> *que){
+//Operation counts and time spent in the store, kept by each test thread for its own operations
+struct OpStats{
+	long reads = 0;
+	long writes = 0;
+	double readSeconds = 0;
+	double writeSeconds = 0;
+};
+
+/*
+Runs 10,000 random operations against kvStore (1 in 5 accumulates, the rest lookups of keys this
+thread has accumulated) and pushes the sum of the values it accumulated onto que. When bufferSize
+is not 0, accumulates go through a private AccumulateBuffer that is merged into the store every
+bufferSize distinct keys and flushed before the sum is reported.
+*/
+template<class Store>
+void threadTest(Store *kvStore, ThreadSafeListenerQueue<int32_t> *que, OpStats *stats, size_t bufferSize){
 	std::time_t start = std::time(nullptr);
+	std::unique_ptr< AccumulateBuffer<Store, std::string, int32_t> > buffer;
+	if(bufferSize > 0)buffer.reset(new AccumulateBuffer<Store, std::string, int32_t>(*kvStore, bufferSize));
 	//Storage for values and keys
 	int32_t valueSum = 0;
 	std::vector<std::string> keys;
@@ -175,6 +243,9 @@ void threadTest(ThreadSafeKVStore<std::string, int32_t> *kvStore, ThreadSafeList
 	std::mt19937 engVal(rdVal());
 	std::uniform_int_distribution<> distrVal(-256, 256);
 
+	//Per-thread engine for picking keys to look up (std::rand() serializes every thread on one lock)
+	std::mt19937 engLookup(rdKey());
+
 	bool passed = true;
 	//Test Loop
 	for(int i = 0; i < 10000; i++){
@@ -190,7 +261,11 @@ void threadTest(ThreadSafeKVStore<std::string, int32_t> *kvStore, ThreadSafeList
 				fullKey = fullKey + std::to_string(key);
 
 				//Accumulate Key-val pair
-				kvStore->accumulate(fullKey, value);
+				auto opStart = std::chrono::steady_clock::now();
+				if(buffer)buffer->accumulate(fullKey, value);
+				else kvStore->accumulate(fullKey, value);
+				stats->writeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - opStart).count();
+				stats->writes++;
 
 				//Keep track of keys and values
 				keys.push_back(fullKey);
@@ -200,49 +275,66 @@ void threadTest(ThreadSafeKVStore<std::string, int32_t> *kvStore, ThreadSafeList
 			//Case to look up existing key-value pair
 			default: {
 				if(keys.size() == 0)break;
-				int randIndex = rand() % keys.size();
+				int randIndex = std::uniform_int_distribution<int>(0, keys.size() - 1)(engLookup);
 				int32_t nonEssential;
-				if(!(kvStore->lookup(keys[randIndex], nonEssential))){
+				auto opStart = std::chrono::steady_clock::now();
+				bool found = kvStore->lookup(keys[randIndex], nonEssential);
+				stats->readSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - opStart).count();
+				stats->reads++;
+				//A key that has not been flushed yet only exists in this thread's buffer
+				if(!found && buffer)found = buffer->lookupPending(keys[randIndex], nonEssential);
+				if(!found){
 					passed = false;
 				}
 				break;
 			}
 		}
 	}
+	if(buffer)buffer->flush();
 	if(!passed)std::cout << "Test Failed" <<std::endl;
 	que->push(valueSum);
 	std::cout << "Time Of Thread: " << std::difftime(time(nullptr), start) << std::endl;
 }
 
 
-int main(int argc, char ** argv){
-	ThreadSafeKVStore<std::string, int32_t> kv;
+/*
+Runs threadTest on threadNum threads against kv, then checks that the sum of the values in the
+store matches the sum the threads report having added. Prints the result and the throughput,
+with reads (lookup) and writes (accumulate) reported separately.
+
+@param kv: the store under test
+@param threadNum: the number of threads to spawn
+@param bufferSize: pending keys per thread before accumulates are merged (0 for no buffering)
+@param scan: whether to keep summing snapshots of the store on another thread while the test runs
+*/
+template<class Store>
+void runTest(Store& kv, int threadNum, size_t bufferSize, bool scan){
 	ThreadSafeListenerQueue<int32_t> q;
 
-	int threadNum = 3;
-	if(argc < 3){
-		std::cout << "Args need to be formatted as: " <<std::endl;
-		std::cout << "lab1 -n <NumberOfThreads>" <<std::endl;
-		return 0;
-	}
-
-	std::string arg1 = argv[1];
-	std::string threadString = argv[2];
-
-	if(arg1.compare("-n") != 0 && arg1.compare("-N") != 0){
-		std::cout << "Args need to be formatted as: " <<std::endl;
-		std::cout << "lab1 -n <NumberOfThreads>" <<std::endl;
-		return 0;
-	}
-
-	threadNum = std::stoi(threadString);	
-
 	std::thread threads[threadNum];
+	std::vector<OpStats> stats(threadNum);
 
 	//Time as threads are running
 	std::time_t start = std::time(nullptr);
+	auto startClock = std::chrono::steady_clock::now();
 	for(int i = 0; i < threadNum;i++){
-		threads[i] = std::thread(threadTest, &kv, &q);
+		threads[i] = std::thread(threadTest<Store>, &kv, &q, &stats[i], bufferSize);
+	}
+
+	//Scanner that aggregates the live store over and over until the test threads are done
+	std::atomic<bool> testing(true);
+	long scans = 0;
+	std::thread scanner;
+	if(scan){
+		scanner = std::thread([&kv, &testing, &scans]{
+			while(testing.load()){
+				int32_t liveSum = 0;
+				kv.snapshot().forEach([&liveSum](const std::string&, int32_t value){
+					liveSum += value;
+				});
+				scans++;
+			}
+		});
 	}
 
 	//Number of threads returned so far
@@ -260,11 +352,15 @@ int main(int argc, char ** argv){
 	for(int i = 0; i < threadNum;i++){
 		threads[i].join();
 	}
-	//Looping through the actual struct
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startClock).count();
+	testing.store(false);
+	if(scan)scanner.join();
+
+	//Looping through a snapshot of the actual struct
 	int32_t sumStructVal = 0;
-	for(auto it = kv.begin(); it!=kv.end(); ++it){
-		sumStructVal += it->second;
-	}
+	kv.snapshot().forEach([&sumStructVal](const std::string&, int32_t value){
+		sumStructVal += value;
+	});
 
 	//Testing if the two values are the same
 	if(sumStructVal != totalValSum){
@@ -279,6 +375,84 @@ int main(int argc, char ** argv){
 	}
 
 	std::cout << "Total Program RunTime: " << std::difftime(std::time(nullptr), start) << std::endl;
+	std::cout << "Throughput (ops/sec): " << (threadNum * 10000.0) / seconds << std::endl;
+
+	//Each thread's rate while it was inside the store, summed over the threads
+	double readRate = 0;
+	double writeRate = 0;
+	for(int i = 0; i < threadNum; i++){
+		if(stats[i].readSeconds > 0)readRate += stats[i].reads / stats[i].readSeconds;
+		if(stats[i].writeSeconds > 0)writeRate += stats[i].writes / stats[i].writeSeconds;
+	}
+	std::cout << "Read Throughput (lookups/sec): " << readRate << std::endl;
+	std::cout << "Write Throughput (accumulates/sec): " << writeRate << std::endl;
+	if(scan)std::cout << "Snapshot Scans During Test: " << scans << std::endl;
+}
+
+int main(int argc, char ** argv){
+	int threadNum = -1;
+	//0 means the single-lock ThreadSafeKVStore
+	int shardNum = 0;
+	//Use reader-writer locks on the shards
+	bool readWrite = false;
+	//0 means every accumulate goes straight to the store
+	int bufferSize = 0;
+	//Scan snapshots of the store while the test threads write to it
+	bool scan = false;
+
+	std::string nLC = "-n"; std::string nUC = "-N";
+	std::string sLC = "-s"; std::string sUC = "-S";
+	std::string rLC = "-r"; std::string rUC = "-R";
+	std::string bLC = "-b"; std::string bUC = "-B";
+	std::string cLC = "-c"; std::string cUC = "-C";
+
+	for(int i = 1; i < argc; i++){
+		if(rLC.compare(argv[i]) == 0 || rUC.compare(argv[i]) == 0){
+			readWrite = true;
+			continue;
+		}
+		if(cLC.compare(argv[i]) == 0 || cUC.compare(argv[i]) == 0){
+			scan = true;
+			continue;
+		}
+		if(i == argc-1)break;
+		std::string next = argv[i+1];
+		if(next.find_first_not_of("0123456789") != std::string::npos)continue;
+		if(nLC.compare(argv[i]) == 0 || nUC.compare(argv[i]) == 0){
+			threadNum = std::stoi(next);
+			i++;
+		}
+		else if(sLC.compare(argv[i]) == 0 || sUC.compare(argv[i]) == 0){
+			shardNum = std::stoi(next);
+			i++;
+		}
+		else if(bLC.compare(argv[i]) == 0 || bUC.compare(argv[i]) == 0){
+			bufferSize = std::stoi(next);
+			i++;
+		}
+	}
+
+	if(threadNum < 1){
+		std::cout << "Args need to be formatted as: " <<std::endl;
+		std::cout << "lab1 -n <NumberOfThreads> [-s <NumberOfShards>] [-r] [-b <BufferedKeys>] [-c]" <<std::endl;
+		return 0;
+	}
+
+	//Reader-writer locking only exists on the sharded store
+	if(readWrite && shardNum == 0)shardNum = 16;
+
+	if(readWrite){
+		ShardedKVStore<std::string, int32_t, ShardRWLock> kv(shardNum);
+		runTest(kv, threadNum, bufferSize, scan);
+	}
+	else if(shardNum > 0){
+		ShardedKVStore<std::string, int32_t> kv(shardNum);
+		runTest(kv, threadNum, bufferSize, scan);
+	}
+	else{
+		ThreadSafeKVStore<std::string, int32_t> kv;
+		runTest(kv, threadNum, bufferSize, scan);
+	}
 
 	return 0;
-}
+}
\ No newline at end of file
@@ -4,8 +4,11 @@
 #include <thread>
 #include <iostream>
 #include <vector>
+#include <chrono>
 #include "worker.h"
+#include "interpolate.h"
 #include "ts_queue.h"
+#include "rng.h"
 
 int main(int argc, char ** argv){
 
@@ -21,11 +24,23 @@ int main(int argc, char ** argv){
 	//the number of worker threads spawned
 	int wThreadNum = -1;
 
+	//the number of initial points; DEGREE + 1 unless -p asks for more
+	int NUM_POINTS = -1;
+
+	//ga searches, exact computes the fit directly and hybrid starts the search from the direct fit
+	std::string solver = "ga";
+
 	//Determines whether the polynomial is defined by x or y
 	bool xNotY = true;
 
 	std::string tLC = "-t"; std::string tUC = "-T";
 	std::string dLC = "-d"; std::string dUC = "-D";
+	std::string seedArg = "--seed";
+	std::string pLC = "-p"; std::string pUC = "-P";
+	std::string solverArg = "--solver";
+
+	//Every random draw in the run descends from this seed; a run is repeated by passing the seed it printed
+	uint64_t seed = Rng::randomSeed();
 
 	for(int i = 1; i < argc-1; i++){
 		std::string next = argv[i+1];
@@ -35,20 +50,37 @@ int main(int argc, char ** argv){
 		else if(tLC.compare(argv[i]) == 0 || tUC.compare(argv[i]) == 0){
 			if(next.find_first_not_of("0123456789") == std::string::npos) wThreadNum = std::stoi(argv[i+1]);
 		}
+		else if(seedArg.compare(argv[i]) == 0){
+			if(next.find_first_not_of("0123456789") == std::string::npos) seed = std::stoull(argv[i+1]);
+		}
+		else if(pLC.compare(argv[i]) == 0 || pUC.compare(argv[i]) == 0){
+			if(next.find_first_not_of("0123456789") == std::string::npos) NUM_POINTS = std::stoi(argv[i+1]);
+		}
+		else if(solverArg.compare(argv[i]) == 0){
+			solver = next;
+		}
 	}
+	if(NUM_POINTS == -1)NUM_POINTS = DEGREE + 1;
 
-	if(wThreadNum == -1 || DEGREE == -1){
+	//The points are integers from -5 to 5 with distinct x-values (or y-values), so there can be at most 11 of them
+	if(wThreadNum == -1 || DEGREE == -1 || NUM_POINTS < DEGREE + 1 || NUM_POINTS > 11
+		|| (solver != "ga" && solver != "exact" && solver != "hybrid")){
 		std::cout << "Arguments must be formatted as: " << std::endl;
-		std::cout << "-d <Degree of Polynomial> -w <Number of worker threads>" << std::endl;
+		std::cout << "-d <Degree of Polynomial> -w <Number of worker threads> [-p <Number of points, Degree + 1 to 11>]";
+		std::cout << " [--solver ga|exact|hybrid] [--seed <Seed>]" << std::endl;
 		return 0;
 	}
 
+	//With more points than DEGREE + 1 there is usually no polynomial within IDEAL_FIT of all of them, so
+	//instead of reseeding when it stalls the search stops and reports the best it found
+	bool overdetermined = NUM_POINTS > DEGREE + 1;
+
 	//array of worker threads
 	std::thread workerThreads[wThreadNum];
 
-	//Random generator for the points
-	std::random_device rand;
-	std::mt19937 eng(rand());
+	//The driver draws the points and seeds from the first stream and each worker gets the next one
+	Rng master(seed);
+	Rng eng = master.fork();
 	std::uniform_int_distribution<> distr(-5, 5);
 
 	/*
@@ -68,7 +100,7 @@ int main(int argc, char ** argv){
 		std::vector< std::pair<float, float> > fresh;
 		INIT_POINTS = fresh;
 		//Generate the points that the polynomial will be bound to
-		for(int i = 0; i < DEGREE + 1; i++){
+		for(int i = 0; i < NUM_POINTS; i++){
 			float x = distr(eng);
 			float y = distr(eng);
 			std::pair<float, float> point (x, y);
@@ -96,79 +128,136 @@ int main(int argc, char ** argv){
 		if(yVal)validPoints = true;
 	}
 
-	//where the current best coefficients will be stored in driver thread
-	std::vector<float> coefficients;
+	//Evaluates fitness against INIT_POINTS for the driver thread
+	FitnessEngine engine(INIT_POINTS);
+
+	//where the current best coefficients and their fitness will be stored in driver thread
+	Candidate best;
 
+	//The direct fit (see interpolate.h) for --solver exact and hybrid
+	Candidate exactFit;
+	if(solver != "ga"){
+		auto start = std::chrono::high_resolution_clock::now();
+		exactFit.coefficients = Interpolator::fit(INIT_POINTS, DEGREE);
+		auto end = std::chrono::high_resolution_clock::now();
+		std::cout << "Direct fit: " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " microseconds" << std::endl;
+		if(!exactFit.coefficients.empty()){
+			exactFit.fitness = engine.fitness(exactFit.coefficients);
+			exactFit.generation = 0;
+			exactFit.workerId = -1;
+			best = exactFit;
+		}
+	}
+	//exact never searches unless the direct fit could not be computed; hybrid also searches when it is not good enough
+	if(!best.coefficients.empty() && (solver == "exact" || best.fitness <= IDEAL_FIT)){
+		wThreadNum = 0;
+	}
+	//Bumped on every reseed so candidates bred from the replaced seeds can be recognised
+	int generation = 0;
+
+	//Every candidate the driver receives is answered with exactly one push to worker_queue and
+	//every candidate a worker takes with one push to driver_queue, so only about wThreadNum
+	//candidates are ever in flight and 1024 slots per queue leave plenty of headroom.
+	const size_t QUEUE_CAPACITY = 1024;
 	//Queue containing coefficients to be mutated by worker threads
-	ThreadSafeListenerQueue< std::vector<float> > worker_queue;
+	BoundedListenerQueue<Candidate> worker_queue(QUEUE_CAPACITY);
 	//Queue containing newly mutated coefficients to be processed by driver thread
-	ThreadSafeListenerQueue< std::vector<float> > driver_queue;
+	BoundedListenerQueue<Candidate> driver_queue(QUEUE_CAPACITY);
 
 	//Start the worker threads and populate wQueue with the initial coefficients
 	for(int i = 0; i < wThreadNum; i++){
-		std::vector<float> seeds;
-		//Generate the starting coefficients
-		for(int j = 0; j < DEGREE + 1; j++){
-			//Prefer to explicitly cast
-			float coef = distr(eng)*5;
-			if(i!=0)coef = coef/i;
-			seeds.push_back(coef);
-		}
-		worker_queue.push(seeds);
-		coefficients = seeds;
-		workerThreads[i] = std::thread(Worker::work, &worker_queue, &driver_queue, &INIT_POINTS);
+		Candidate initial;
+		if(!exactFit.coefficients.empty()){
+			//Every worker starts from the direct fit
+			initial = exactFit;
+		}
+		else{
+			//Generate the starting coefficients
+			for(int j = 0; j < DEGREE + 1; j++){
+				//Prefer to explicitly cast
+				float coef = distr(eng)*5;
+				if(i!=0)coef = coef/i;
+				initial.coefficients.push_back(coef);
+			}
+			initial.fitness = engine.fitness(initial.coefficients);
+			initial.generation = generation;
+			initial.workerId = -1;
+		}
+		if(best.coefficients.empty() || initial.fitness < best.fitness)best = initial;
+		worker_queue.push(std::move(initial));
+		workerThreads[i] = std::thread(Worker::work, &worker_queue, &driver_queue, &INIT_POINTS, i, master.fork());
 	}
 
 	int iteration_count = 0;
 
-	float currentFitness = Worker::fitness(coefficients, INIT_POINTS);
-	std::cout << currentFitness << std::endl;
+	std::cout << "Seed: " << seed << std::endl;
+	std::cout << best.fitness << std::endl;
+
+	//Candidates are taken from driver_queue and answered on worker_queue a batch at a time, so
+	//the driver claims each queue once per batch instead of once per candidate
+	const size_t DRIVER_BATCH = 64;
+	std::vector<Candidate> received;
+	std::vector<Candidate> replies;
+	bool stalled = false;
+
 	//Driver loop while worker threads are producing new coefficients
-	while(currentFitness > IDEAL_FIT){
+	while(wThreadNum > 0 && best.fitness > IDEAL_FIT && !stalled){
 		//Get new coefficients w/computed fitness from queue
-		std::vector<float> newCoeffs;
-		if(driver_queue.listen(newCoeffs)){
-			//compare the fitness of two coefficients
-			if(currentFitness > Worker::fitness(newCoeffs, INIT_POINTS)){
-				//if the newCoeffs has better fitness, replace the old one
-				worker_queue.push(newCoeffs);
-				for(int i = 0; i < coefficients.size(); i++){
-					coefficients[i] = newCoeffs[i];
-				}
-				currentFitness = Worker::fitness(coefficients, INIT_POINTS);
+		received.clear();
+		driver_queue.listen_batch(received, DRIVER_BATCH);
+		replies.clear();
+		for(size_t c = 0; c < received.size() && best.fitness > IDEAL_FIT && !stalled; c++){
+			Candidate& candidate = received[c];
+			//Bred from seeds a reseed replaced. It is not answered, which brings the number of
+			//candidates in flight back to wThreadNum.
+			if(candidate.generation != generation)continue;
+			//compare the fitness of two coefficients; the worker already scored the candidate
+			if(best.fitness > candidate.fitness){
+				//if the candidate has better fitness, replace the old one
+				best = candidate;
+				replies.push_back(std::move(candidate));
+			}
+			else if(iteration_count > (30000*DEGREE) && overdetermined){
+				//The best fit there is has probably been found
+				stalled = true;
 			}
 			else if(iteration_count > (30000*DEGREE)){
 				//This is hit because the program has hit a wall
-				//Reseed with new starting coefficients
-				std::vector<float> bs;
-				while(worker_queue.pop(bs)){}
-				while(driver_queue.pop(bs)){}
+				//Reseed with new starting coefficients. Replies not yet sent came from the old
+				//coefficients, so they are dropped as well.
+				std::vector<Candidate> bs;
+				worker_queue.drain(bs);
+				replies.clear();
+				generation++;
 				for(int j = 0; j <wThreadNum; j++){
-					std::vector<float> newSeeds;
+					Candidate newSeed;
 					for(int i = 0; i < DEGREE + 1; i++){
 						//Prefer to explicitly cast
 						float coef = distr(eng)*15;
 						if(i!=0)coef = coef /i;
-						newSeeds.push_back(coef);
+						newSeed.coefficients.push_back(coef);
 					}
-					worker_queue.push(newSeeds);
-					coefficients = newSeeds;
+					newSeed.fitness = engine.fitness(newSeed.coefficients);
+					newSeed.generation = generation;
+					newSeed.workerId = -1;
+					if(j == 0 || newSeed.fitness < best.fitness)best = newSeed;
+					replies.push_back(std::move(newSeed));
 				}
-				currentFitness = Worker::fitness(coefficients, INIT_POINTS);
 				iteration_count = 0;
 			}
 			else{
-				worker_queue.push(coefficients);
+				replies.push_back(best);
 			}
-			iteration_count++;
+			//Each candidate stands for a whole population of mutations
+			iteration_count += Worker::POPULATION;
 		}
+		worker_queue.push_batch(std::make_move_iterator(replies.begin()), std::make_move_iterator(replies.end()));
 	}
 
-	//Make sure all the threads know the best fit has been found
-	for(int i = 0; i < 2*wThreadNum; i++){
-		std::vector<float> empty;
-		worker_queue.push(empty);
-	}
+	//Make sure all the threads know the best fit has been found: closing wakes every worker
+	//listening on worker_queue and any worker still pushing to driver_queue
+	worker_queue.close();
+	driver_queue.close();
 
 	//Work done -> join the threads
 	for(int i = 0; i < wThreadNum; i++){
@@ -203,18 +292,20 @@ int main(int argc, char ** argv){
 
 	std::cout << "Polynomial: " << std::endl;
 	char print = charY;
-	for(int i = 0; i < coefficients.size(); i++){
+	for(int i = 0; i < best.coefficients.size(); i++){
 		if(xNotY)print = charX;
-		if(i == 0)std::cout << coefficients[i];
-		else if(i == 1) std::cout << coefficients[i] << print;
+		if(i == 0)std::cout << best.coefficients[i];
+		else if(i == 1) std::cout << best.coefficients[i] << print;
 		else{
-			std::cout << coefficients[i] << print << "^" << i;
+			std::cout << best.coefficients[i] << print << "^" << i;
 		}
-		if(i != coefficients.size())std::cout << " + ";
+		if(i != best.coefficients.size())std::cout << " + ";
 	}
 	std::cout << std::endl;
 
-	std::cout << "Fitness: " << currentFitness << std::endl;
+	std::cout << "Fitness: " << best.fitness << std::endl;
+	if(best.workerId == -1)std::cout << "Found by the driver in generation " << best.generation << std::endl;
+	else std::cout << "Found by worker " << best.workerId << " in generation " << best.generation << std::endl;
 
 	return 0;
 }
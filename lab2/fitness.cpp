@@ -0,0 +1,152 @@
+#include "fitness.h"
+#include <cmath>
+#include <vector>
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX512F__)
+const size_t FitnessEngine::LANES = 16;
+#elif defined(__AVX2__)
+const size_t FitnessEngine::LANES = 8;
+#else
+const size_t FitnessEngine::LANES = 1;
+#endif
+
+#if defined(__AVX2__) && !defined(__AVX512F__)
+//Adds up the 8 floats in v
+static inline float horizontalSum(__m256 v){
+	__m128 half = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+	half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+	return _mm_cvtss_f32(half);
+}
+#endif
+
+FitnessEngine::FitnessEngine(const std::vector< std::pair<float, float> >& points) : count(points.size()){
+	size_t padded = (count + LANES - 1) / LANES * LANES;
+	xs.assign(padded, 0);
+	ys.assign(padded, 0);
+	weights.assign(padded, 0);
+	for(size_t i = 0; i < count; i++){
+		xs[i] = points[i].first;
+		ys[i] = points[i].second;
+		weights[i] = 1;
+	}
+}
+
+float FitnessEngine::fitness(const float * coefficients, size_t n) const{
+	//Horner's rule starts from the highest coefficient; with none the polynomial is 0 everywhere
+	size_t last = n > 0 ? n - 1 : 0;
+	float top = n > 0 ? coefficients[last] : 0;
+	float fitness = 0;
+#if defined(__AVX512F__) || defined(__AVX2__)
+	//The padded lanes are weighted by 0, so whole registers can be loaded up to the end
+	size_t padded = xs.size();
+#endif
+#if defined(__AVX512F__)
+	__m512 sum = _mm512_setzero_ps();
+	for(size_t i = 0; i < padded; i += LANES){
+		__m512 x = _mm512_loadu_ps(&xs[i]);
+		//Horner's rule: ((c[n-1]*x + c[n-2])*x + ...)*x + c[0]
+		__m512 calcY = _mm512_set1_ps(top);
+		for(size_t j = last; j-- > 0;){
+			calcY = _mm512_fmadd_ps(calcY, x, _mm512_set1_ps(coefficients[j]));
+		}
+		__m512 diff = _mm512_abs_ps(_mm512_sub_ps(calcY, _mm512_loadu_ps(&ys[i])));
+		sum = _mm512_fmadd_ps(diff, _mm512_loadu_ps(&weights[i]), sum);
+	}
+	fitness = _mm512_reduce_add_ps(sum);
+#elif defined(__AVX2__)
+	const __m256 signBit = _mm256_set1_ps(-0.0f);
+	__m256 sum = _mm256_setzero_ps();
+	for(size_t i = 0; i < padded; i += LANES){
+		__m256 x = _mm256_loadu_ps(&xs[i]);
+		//Horner's rule: ((c[n-1]*x + c[n-2])*x + ...)*x + c[0]
+		__m256 calcY = _mm256_set1_ps(top);
+		for(size_t j = last; j-- > 0;){
+#if defined(__FMA__)
+			calcY = _mm256_fmadd_ps(calcY, x, _mm256_set1_ps(coefficients[j]));
+#else
+			calcY = _mm256_add_ps(_mm256_mul_ps(calcY, x), _mm256_set1_ps(coefficients[j]));
+#endif
+		}
+		//Clearing the sign bit is the absolute value
+		__m256 diff = _mm256_andnot_ps(signBit, _mm256_sub_ps(calcY, _mm256_loadu_ps(&ys[i])));
+		sum = _mm256_add_ps(sum, _mm256_mul_ps(diff, _mm256_loadu_ps(&weights[i])));
+	}
+	fitness = horizontalSum(sum);
+#else
+	for(size_t i = 0; i < count; i++){
+		//Horner's rule: ((c[n-1]*x + c[n-2])*x + ...)*x + c[0]
+		float calcY = top;
+		for(size_t j = last; j-- > 0;){
+			calcY = calcY * xs[i] + coefficients[j];
+		}
+		//compare the difference between the two y-values
+		fitness += std::abs(calcY - ys[i]);
+	}
+#endif
+	return fitness;
+}
+
+float FitnessEngine::fitness(const std::vector<float>& coefficients) const{
+	return fitness(coefficients.data(), coefficients.size());
+}
+
+void FitnessEngine::fitnessBatch(const float * coefficients, size_t k, size_t n, float * results) const{
+	size_t last = n > 0 ? n - 1 : 0;
+	size_t i = 0;
+#if defined(__AVX512F__)
+	//Each lane is a candidate; the points are broadcast one at a time
+	for(; n > 0 && i + LANES <= k; i += LANES){
+		__m512 sum = _mm512_setzero_ps();
+		for(size_t p = 0; p < count; p++){
+			__m512 x = _mm512_set1_ps(xs[p]);
+			__m512 calcY = _mm512_loadu_ps(&coefficients[last * k + i]);
+			for(size_t j = last; j-- > 0;){
+				calcY = _mm512_fmadd_ps(calcY, x, _mm512_loadu_ps(&coefficients[j * k + i]));
+			}
+			sum = _mm512_add_ps(sum, _mm512_abs_ps(_mm512_sub_ps(calcY, _mm512_set1_ps(ys[p]))));
+		}
+		_mm512_storeu_ps(&results[i], sum);
+	}
+#elif defined(__AVX2__)
+	//Each lane is a candidate; the points are broadcast one at a time
+	const __m256 signBit = _mm256_set1_ps(-0.0f);
+	for(; n > 0 && i + LANES <= k; i += LANES){
+		__m256 sum = _mm256_setzero_ps();
+		for(size_t p = 0; p < count; p++){
+			__m256 x = _mm256_set1_ps(xs[p]);
+			__m256 calcY = _mm256_loadu_ps(&coefficients[last * k + i]);
+			for(size_t j = last; j-- > 0;){
+#if defined(__FMA__)
+				calcY = _mm256_fmadd_ps(calcY, x, _mm256_loadu_ps(&coefficients[j * k + i]));
+#else
+				calcY = _mm256_add_ps(_mm256_mul_ps(calcY, x), _mm256_loadu_ps(&coefficients[j * k + i]));
+#endif
+			}
+			sum = _mm256_add_ps(sum, _mm256_andnot_ps(signBit, _mm256_sub_ps(calcY, _mm256_set1_ps(ys[p]))));
+		}
+		_mm256_storeu_ps(&results[i], sum);
+	}
+#endif
+	//The scalar build, and any candidates left over after the last full register. Candidates are
+	//the inner loop so each coefficient row is read in order.
+	for(size_t c = i; c < k; c++){
+		results[c] = 0;
+	}
+	for(size_t p = 0; p < count; p++){
+		for(size_t c = i; c < k; c++){
+			float calcY = n > 0 ? coefficients[last * k + c] : 0;
+			for(size_t j = last; j-- > 0;){
+				calcY = calcY * xs[p] + coefficients[j * k + c];
+			}
+			results[c] += std::abs(calcY - ys[p]);
+		}
+	}
+}
+
+size_t FitnessEngine::size() const{
+	return count;
+}
@@ -0,0 +1,62 @@
+#ifndef FITNESS_H_
+#define FITNESS_H_
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+/*
+Evaluates the fitness metric described in the READ_ME file (the sum of |polynomial(x) - y| over the
+initial points) for many coefficient sets against one fixed set of points. The points are copied once
+into separate x and y arrays (structure of arrays) padded to a whole number of SIMD registers, and the
+polynomial is evaluated with Horner's rule, so there are no calls to std::pow. Each instruction covers
+16 points when compiled with AVX-512 (-mavx512f or -march=native), 8 with AVX2 (-mavx2) and 1 otherwise.
+*/
+class FitnessEngine{
+	private:
+		//Points per SIMD register for the instruction set this file was compiled with
+		static const size_t LANES;
+
+		//x and y of each point, then padding up to a multiple of LANES
+		std::vector<float> xs;
+		std::vector<float> ys;
+		//1 for a real point and 0 for padding, so padded lanes add nothing to the sum
+		std::vector<float> weights;
+		//the number of real points
+		size_t count;
+	public:
+		/*
+		Lays out points for evaluation. The engine keeps its own copy.
+
+		@param points - the intitial points that the polynomial is bounded to
+		*/
+		explicit FitnessEngine(const std::vector< std::pair<float, float> >& points);
+
+		/*
+		Calculates the fitness of one set of coefficients.
+
+		@param coefficients - the coefficients, from lowest degree to highest {x^0, x^1, ..., x^n}
+		@param n - the number of coefficients
+
+		@return the calculated fitness of the set of coefficients.
+		*/
+		float fitness(const float * coefficients, size_t n) const;
+		float fitness(const std::vector<float>& coefficients) const;
+
+		/*
+		Calculates the fitness of k sets of coefficients in one pass. The coefficients are stored
+		coefficient-major: coefficients[j*k + i] is coefficient j of candidate i. That puts the same
+		coefficient of neighbouring candidates side by side, so one SIMD register evaluates LANES
+		candidates at a time while the points stay in cache.
+
+		@param coefficients - the n x k matrix of coefficients, coefficient-major
+		@param k - the number of candidates
+		@param n - the number of coefficients per candidate
+		@param results - where the k fitness values are written, in candidate order
+		*/
+		void fitnessBatch(const float * coefficients, size_t k, size_t n, float * results) const;
+
+		//The number of points the engine evaluates against
+		size_t size() const;
+};
+
+#endif
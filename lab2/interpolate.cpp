@@ -0,0 +1,120 @@
+#include "interpolate.h"
+#include <cmath>
+#include <vector>
+
+std::vector<float> Interpolator::newton(const std::vector< std::pair<float, float> >& points){
+	int n = points.size();
+	std::vector<float> coefficients;
+	if(n == 0)return coefficients;
+
+	//Divided differences computed in place: after pass k, diff[i] holds f[x(i-k), ..., x(i)] for i >= k
+	std::vector<double> diff(n);
+	for(int i = 0; i < n; i++){
+		diff[i] = points[i].second;
+	}
+	for(int k = 1; k < n; k++){
+		for(int i = n - 1; i >= k; i--){
+			double dx = (double)points[i].first - points[i - k].first;
+			if(dx == 0)return coefficients;
+			diff[i] = (diff[i] - diff[i - 1]) / dx;
+		}
+	}
+
+	//Expand diff[0] + (x - x0)(diff[1] + (x - x1)(diff[2] + ...)) from the inside out
+	std::vector<double> poly(1, diff[n - 1]);
+	for(int k = n - 2; k >= 0; k--){
+		//poly = poly * (x - x(k)) + diff[k]
+		double root = points[k].first;
+		poly.push_back(0);
+		for(int j = poly.size() - 1; j > 0; j--){
+			poly[j] = poly[j - 1] - root * poly[j];
+		}
+		poly[0] = diff[k] - root * poly[0];
+	}
+
+	coefficients.assign(poly.begin(), poly.end());
+	return coefficients;
+}
+
+std::vector<float> Interpolator::leastSquares(const std::vector< std::pair<float, float> >& points, int degree){
+	int m = points.size();
+	int n = degree + 1;
+	std::vector<float> coefficients;
+	if(degree < 0 || m < n)return coefficients;
+
+	//The Vandermonde matrix, row-major: a[i*n + j] = x(i)^j. b holds the y-values.
+	std::vector<double> a(m * n);
+	std::vector<double> b(m);
+	double scale = 0;
+	for(int i = 0; i < m; i++){
+		double power = 1;
+		for(int j = 0; j < n; j++){
+			a[i * n + j] = power;
+			if(std::abs(power) > scale)scale = std::abs(power);
+			power *= points[i].first;
+		}
+		b[i] = points[i].second;
+	}
+
+	//Householder QR: column k is reflected onto the diagonal, and the same reflection is applied to the
+	//columns to its right and to b, so b ends up as Q^T b without Q ever being stored
+	std::vector<double> v(m);
+	for(int k = 0; k < n; k++){
+		double norm = 0;
+		for(int i = k; i < m; i++){
+			norm += a[i * n + k] * a[i * n + k];
+		}
+		norm = std::sqrt(norm);
+		//A zero column below the diagonal means the x-values cannot pin down this coefficient
+		if(norm <= 1e-12 * scale)return coefficients;
+		double alpha = a[k * n + k] > 0 ? -norm : norm;
+
+		double vNorm = 0;
+		for(int i = k; i < m; i++){
+			v[i] = a[i * n + k];
+		}
+		v[k] -= alpha;
+		for(int i = k; i < m; i++){
+			vNorm += v[i] * v[i];
+		}
+
+		//H = I - 2vv^T / (v^T v); column k becomes (alpha, 0, ..., 0)
+		for(int j = k + 1; j < n; j++){
+			double dot = 0;
+			for(int i = k; i < m; i++){
+				dot += v[i] * a[i * n + j];
+			}
+			double factor = 2 * dot / vNorm;
+			for(int i = k; i < m; i++){
+				a[i * n + j] -= factor * v[i];
+			}
+		}
+		double dot = 0;
+		for(int i = k; i < m; i++){
+			dot += v[i] * b[i];
+		}
+		double factor = 2 * dot / vNorm;
+		for(int i = k; i < m; i++){
+			b[i] -= factor * v[i];
+		}
+		a[k * n + k] = alpha;
+	}
+
+	//Back substitution on the upper triangle R x = (Q^T b) for the first n rows
+	std::vector<double> x(n);
+	for(int k = n - 1; k >= 0; k--){
+		double sum = b[k];
+		for(int j = k + 1; j < n; j++){
+			sum -= a[k * n + j] * x[j];
+		}
+		x[k] = sum / a[k * n + k];
+	}
+
+	coefficients.assign(x.begin(), x.end());
+	return coefficients;
+}
+
+std::vector<float> Interpolator::fit(const std::vector< std::pair<float, float> >& points, int degree){
+	if((int)points.size() == degree + 1)return Interpolator::newton(points);
+	return Interpolator::leastSquares(points, degree);
+}
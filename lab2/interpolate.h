@@ -0,0 +1,47 @@
+#ifndef INTERPOLATE_H_
+#define INTERPOLATE_H_
+#include <vector>
+#include <utility>
+
+/*
+Closed-form fits for the problem the genetic search solves. With DEGREE + 1 points that have distinct x-values there is
+exactly one polynomial of degree DEGREE through all of them, and it can be computed directly instead of searched for.
+With more points than that, the least-squares polynomial is the usual best answer, and a good place for the search to
+start when the data is noisy. The arithmetic is done in double and the coefficients are returned as float, from
+lowest degree to highest {x^0, x^1, ..., x^n} like everywhere else in the lab.
+*/
+class Interpolator{
+	public:
+		/*
+		Interpolates the points with Newton's divided differences and expands the result into monomial coefficients.
+
+		@param points - the points to pass through; every x must be distinct
+
+		@return points.size() coefficients, or an empty vector if two points share an x
+		*/
+		static std::vector<float> newton(const std::vector< std::pair<float, float> >& points);
+
+		/*
+		Fits a polynomial of the given degree to the points in the least-squares sense, by a Householder QR
+		factorization of the Vandermonde matrix. That avoids forming the normal equations, which would square
+		the matrix's condition number.
+
+		@param points - the points to fit, at least degree + 1 of them
+		@param degree - the degree of the polynomial
+
+		@return degree + 1 coefficients, or an empty vector if there are too few distinct x-values to determine them
+		*/
+		static std::vector<float> leastSquares(const std::vector< std::pair<float, float> >& points, int degree);
+
+		/*
+		Uses newton when there are exactly degree + 1 points and leastSquares when there are more.
+
+		@param points - the points to fit
+		@param degree - the degree of the polynomial
+
+		@return degree + 1 coefficients, or an empty vector if they cannot be determined
+		*/
+		static std::vector<float> fit(const std::vector< std::pair<float, float> >& points, int degree);
+};
+
+#endif
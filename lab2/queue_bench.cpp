@@ -0,0 +1,133 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ts_queue.h"
+
+//Every heap allocation in the program goes through here so a run can count them
+static size_t allocations = 0;
+
+void * operator new(size_t size){
+	allocations++;
+	void * p = std::malloc(size == 0 ? 1 : size);
+	if(p == nullptr)throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void * p) noexcept{
+	std::free(p);
+}
+
+//Coefficient vectors in lab2 are DEGREE + 1 floats; the payload size only changes the cost of a copy
+static const int PAYLOAD = 16;
+
+/*
+The push the list queue had before push(const T&) and push(T&&): the element was taken by value, so
+the caller's message was copied into the parameter and then copied again into the list node.
+
+@param queue - the queue to push to
+@param element - the message, copied on the way in
+*/
+template<class Queue>
+void legacyPush(Queue& queue, const std::vector<float> element){
+	queue.push(element);
+}
+
+/*
+Pushes and then pops messages one at a time through queue; send(queue, i) builds message i and puts
+it in the queue. Prints the heap allocations and the time per message. The allocation that builds the
+message itself is counted, since every producer in the labs has to make one.
+
+@param name - the label printed for this run
+@param queue - the queue under test
+@param messages - how many messages to send through
+@param send - builds message i and enqueues it (by copy, move or emplace)
+*/
+template<class Queue, class Send>
+void run(const std::string name, Queue& queue, int messages, Send send){
+	std::vector<float> out;
+	out.reserve(PAYLOAD);
+	size_t before = allocations;
+	auto start = std::chrono::high_resolution_clock::now();
+	for(int i = 0; i < messages; i++){
+		send(queue, i);
+		queue.pop(out);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	double nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	std::cout << name << ": " << (double)(allocations - before) / messages << " allocations/message, "
+		<< nanos / messages << " ns/message" << std::endl;
+}
+
+/*
+Same as run, but moves the messages through the queue BATCH at a time with push_batch/pop_batch.
+
+@param name - the label printed for this run
+@param queue - the queue under test
+@param messages - how many messages to send through
+*/
+template<class Queue>
+void runBatch(const std::string name, Queue& queue, int messages){
+	static const int BATCH = 64;
+	std::vector< std::vector<float> > in;
+	std::vector< std::vector<float> > out;
+	size_t before = allocations;
+	auto start = std::chrono::high_resolution_clock::now();
+	for(int i = 0; i < messages; i += BATCH){
+		in.clear();
+		out.clear();
+		for(int j = 0; j < BATCH; j++){
+			in.emplace_back(PAYLOAD, (float)(i + j));
+		}
+		queue.push_batch(std::make_move_iterator(in.begin()), std::make_move_iterator(in.end()));
+		queue.pop_batch(out, BATCH);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	double nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	std::cout << name << ": " << (double)(allocations - before) / messages << " allocations/message, "
+		<< nanos / messages << " ns/message" << std::endl;
+}
+
+int main(int argc, char ** argv){
+	int messages = 1000000;
+	if(argc > 1)messages = std::stoi(argv[1]);
+
+	ThreadSafeListenerQueue< std::vector<float> > list;
+	BoundedListenerQueue< std::vector<float> > ring(1024);
+
+	//The old by-value push, for the before figure. The old pop copied out of the node instead of moving,
+	//but into out's reserved capacity, so that changes the time and not the allocation count.
+	run("list legacy push(T)", list, messages, [](ThreadSafeListenerQueue< std::vector<float> >& q, int i){
+		std::vector<float> message(PAYLOAD, (float)i);
+		legacyPush(q, message);
+	});
+	//Copying: the message is built, then copied into the queue
+	run("list push(const T&)", list, messages, [](ThreadSafeListenerQueue< std::vector<float> >& q, int i){
+		std::vector<float> message(PAYLOAD, (float)i);
+		q.push(message);
+	});
+	run("list push(T&&)     ", list, messages, [](ThreadSafeListenerQueue< std::vector<float> >& q, int i){
+		std::vector<float> message(PAYLOAD, (float)i);
+		q.push(std::move(message));
+	});
+	run("list emplace       ", list, messages, [](ThreadSafeListenerQueue< std::vector<float> >& q, int i){
+		q.emplace(PAYLOAD, (float)i);
+	});
+	run("ring push(const T&)", ring, messages, [](BoundedListenerQueue< std::vector<float> >& q, int i){
+		std::vector<float> message(PAYLOAD, (float)i);
+		q.push(message);
+	});
+	run("ring push(T&&)     ", ring, messages, [](BoundedListenerQueue< std::vector<float> >& q, int i){
+		std::vector<float> message(PAYLOAD, (float)i);
+		q.push(std::move(message));
+	});
+	run("ring emplace       ", ring, messages, [](BoundedListenerQueue< std::vector<float> >& q, int i){
+		q.emplace(PAYLOAD, (float)i);
+	});
+	runBatch("list batch of 64   ", list, messages);
+	runBatch("ring batch of 64   ", ring, messages);
+	return 0;
+}
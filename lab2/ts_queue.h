@@ -7,6 +7,20 @@
 #include <unordered_map>
 #include <iterator>
 #include <chrono>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <algorithm>
+
+/*
+What a listen returned with: Ready when an element was removed, Timeout when a timed listen ran out
+of time first, and Closed when the queue has been closed and everything pushed before that is gone.
+*/
+enum class QueueStatus{Ready, Timeout, Closed};
 
 template<class T>
 class ThreadSafeListenerQueue{
@@ -16,17 +30,51 @@ class ThreadSafeListenerQueue{
 		//Mutex and Condition Variables to synchronize ThreadSafeListenerQueue
 		std::mutex mList;
 		std::condition_variable cv;
+
+		//Set once by close(), guarded by mList
+		bool isClosed = false;
+
+		//Sleeps on cv until storage has an element, the queue is closed or timeout passes. A timeout
+		//of FOREVER never expires. The caller must hold lock on mList.
+		static constexpr std::chrono::milliseconds FOREVER = std::chrono::milliseconds::max();
+		QueueStatus waitForElement(std::unique_lock<std::mutex>& lock, std::chrono::milliseconds timeout);
+
+		//Unlinks up to max of the oldest nodes into taken. The caller must hold mList.
+		void takeOldest(std::list<T>& taken, size_t max);
+
+		//Moves the nodes unlinked by takeOldest into out, oldest first, and returns how many there were
+		static size_t moveOut(std::list<T>& taken, std::vector<T>& out);
 	public:
 		/*
-		Inserts an item to front of the queue. Returns true if inserted successfully.
+		Inserts an item to front of the queue. Returns true if inserted successfully and false if
+		the queue has been closed.
 	
 		@param element: element to be added to the queue
 		@returns true when the item is successfully inserted.
 		*/
-		bool push(const T element);
+		bool push(const T& element);
+
+		/*
+		Moves an item to front of the queue instead of copying it. Returns true if inserted successfully
+		and false if the queue has been closed.
+
+		@param element: element to be moved into the queue
+		@returns true when the item is successfully inserted.
+		*/
+		bool push(T&& element);
+
+		/*
+		Constructs an item in place at the front of the queue from args. Returns true if inserted
+		successfully and false if the queue has been closed.
+
+		@param args: the arguments passed to T's constructor
+		@returns true when the item is successfully inserted.
+		*/
+		template<class... Args>
+		bool emplace(Args&&... args);
 
 		/*
-		Removes the element that has been in the queue the longest and stores it in
+		Removes the element that has been in the queue the longest and moves it into
 		the parameter element. Returns true if an element has been removed and false
 		if the list is empty.
 
@@ -36,31 +84,125 @@ class ThreadSafeListenerQueue{
 		bool pop(T& element);
 
 		/*
-		Removes the element that has been in the queue the longest and stores it in
-		the parameter element. Returns true if an element has been removed and false
-		if the list is empty. If the queue is empty, it puts the thread to sleep until
-		there is an element in the queue.
+		Removes the element that has been in the queue the longest and moves it into
+		the parameter element. If the queue is empty, it puts the thread to sleep until
+		there is an element in the queue or the queue is closed.
 
 		@param element: where the removed element will be stored
-		@returns true when an element is removed
+		@returns Ready when an element is removed, Closed once the queue is closed and empty
+		*/
+		QueueStatus listen(T& element);
+
+		/*
+		Same as listen, but gives up once timeout has passed.
+
+		@param element: where the removed element will be stored
+		@param timeout: how long to wait for an element
+		@returns Ready when an element is removed, Timeout if none arrived in time, Closed once
+		the queue is closed and empty
+		*/
+		QueueStatus listen_for(T& element, std::chrono::milliseconds timeout);
+
+		/*
+		Closes the queue: later pushes fail and every thread sleeping in a listen wakes up. Elements
+		already in the queue can still be removed; listens return Closed once it is empty.
+		*/
+		void close();
+
+		/*
+		Inserts every item in [first, last) with a single lock acquisition. Items are queued in
+		range order, so first is popped before last. Pass move iterators to move the items in.
+
+		@param first: the first item to be added
+		@param last: one past the last item to be added
+		@returns true when the items are successfully inserted, false if the queue has been closed
+		*/
+		template<class InputIt>
+		bool push_batch(InputIt first, InputIt last);
+
+		/*
+		Removes up to max of the oldest elements with a single lock acquisition and appends
+		them to out, oldest first. Does not wait if the queue is empty.
+
+		@param out: where the removed elements will be appended
+		@param max: the most elements to remove
+		@returns the number of elements removed
 		*/
-		bool listen(T& element);
+		size_t pop_batch(std::vector<T>& out, size_t max);
+
+		/*
+		Removes every element in the queue with a single lock acquisition and appends them to
+		out, oldest first.
+
+		@param out: where the removed elements will be appended
+		@returns the number of elements removed
+		*/
+		size_t drain(std::vector<T>& out);
+
+		/*
+		Same as pop_batch, but if the queue is empty, it puts the thread to sleep until there is
+		an element in the queue or the queue is closed.
+
+		@param out: where the removed elements will be appended
+		@param max: the most elements to remove
+		@returns Ready when at least one element is removed, Closed once the queue is closed and empty
+		*/
+		QueueStatus listen_batch(std::vector<T>& out, size_t max);
+
+		/*
+		Same as listen_batch, but gives up once timeout has passed.
+
+		@param out: where the removed elements will be appended
+		@param max: the most elements to remove
+		@param timeout: how long to wait for the first element
+		@returns Ready when at least one element is removed, Timeout if none arrived in time, Closed
+		once the queue is closed and empty
+		*/
+		QueueStatus listen_batch_for(std::vector<T>& out, size_t max, std::chrono::milliseconds timeout);
 };
 /*
-Inserts an item to front of the queue. Returns true if inserted successfully.
+Inserts an item to front of the queue. Returns true if inserted successfully and false if
+the queue has been closed.
 @param element: element to be added to the queue
 @returns true when the item is successfully inserted.
 */
 template<class T>
-bool ThreadSafeListenerQueue<T>::push(const T element){
+bool ThreadSafeListenerQueue<T>::push(const T& element){
+	return ThreadSafeListenerQueue<T>::emplace(element);
+}
+
+/*
+Moves an item to front of the queue instead of copying it. Returns true if inserted successfully
+and false if the queue has been closed.
+@param element: element to be moved into the queue
+@returns true when the item is successfully inserted.
+*/
+template<class T>
+bool ThreadSafeListenerQueue<T>::push(T&& element){
+	return ThreadSafeListenerQueue<T>::emplace(std::move(element));
+}
+
+/*
+Constructs an item in place at the front of the queue from args. Returns true if inserted
+successfully and false if the queue has been closed.
+@param args: the arguments passed to T's constructor
+@returns true when the item is successfully inserted.
+*/
+template<class T>
+template<class... Args>
+bool ThreadSafeListenerQueue<T>::emplace(Args&&... args){
+	//Allocate and build the node before taking the lock, then just link it in
+	std::list<T> node;
+	node.emplace_front(std::forward<Args>(args)...);
 	std::lock_guard<std::mutex> lock(ThreadSafeListenerQueue<T>::mList);
-	ThreadSafeListenerQueue<T>::storage.push_front(element);
+	if(ThreadSafeListenerQueue<T>::isClosed)return false;
+	ThreadSafeListenerQueue<T>::storage.splice(ThreadSafeListenerQueue<T>::storage.begin(), node);
 	ThreadSafeListenerQueue<T>::cv.notify_one();
 	return true;
 }
 
 /*
-Removes the element that has been in the queue the longest and stores it in
+Removes the element that has been in the queue the longest and moves it into
 the parameter element. Returns true if an element has been removed and false
 if the list is empty.
 @param element: where the removed element will be stored
@@ -70,31 +212,653 @@ template<class T>
 bool ThreadSafeListenerQueue<T>::pop(T& element){
 	std::lock_guard<std::mutex> lock(ThreadSafeListenerQueue<T>::mList);
 	if(ThreadSafeListenerQueue<T>::storage.empty())return false;
-	element = ThreadSafeListenerQueue<T>::storage.back();
+	element = std::move(ThreadSafeListenerQueue<T>::storage.back());
 	ThreadSafeListenerQueue<T>::storage.pop_back();
 	return true;
 }
 
+template<class T>
+constexpr std::chrono::milliseconds ThreadSafeListenerQueue<T>::FOREVER;
+
+template<class T>
+QueueStatus ThreadSafeListenerQueue<T>::waitForElement(std::unique_lock<std::mutex>& lock, std::chrono::milliseconds timeout){
+	auto ready = [this]{return !(this->storage.empty()) || this->isClosed;};
+	if(timeout == FOREVER){
+		cv.wait(lock, ready);
+	}
+	else{
+		cv.wait_for(lock, timeout, ready);
+	}
+	//Whatever was pushed before close() is still handed out
+	if(!ThreadSafeListenerQueue<T>::storage.empty())return QueueStatus::Ready;
+	return ThreadSafeListenerQueue<T>::isClosed ? QueueStatus::Closed : QueueStatus::Timeout;
+}
+
 /*
-Removes the element that has been in the queue the longest and stores it in
-the parameter element. Returns true if an element has been removed and false
-if the list is empty. If the queue is empty, it puts the thread to sleep until
-there is an element in the queue.
+Removes the element that has been in the queue the longest and moves it into
+the parameter element. If the queue is empty, it puts the thread to sleep until
+there is an element in the queue or the queue is closed.
 @param element: where the removed element will be stored
-@returns true when an element is removed
+@returns Ready when an element is removed, Closed once the queue is closed and empty
 */
 template<class T>
-bool ThreadSafeListenerQueue<T>::listen(T& element){
-	std::chrono::milliseconds mil(1000);
+QueueStatus ThreadSafeListenerQueue<T>::listen(T& element){
+	return ThreadSafeListenerQueue<T>::listen_for(element, FOREVER);
+}
+
+/*
+Same as listen, but gives up once timeout has passed.
+@param element: where the removed element will be stored
+@param timeout: how long to wait for an element
+@returns Ready when an element is removed, Timeout if none arrived in time, Closed once
+the queue is closed and empty
+*/
+template<class T>
+QueueStatus ThreadSafeListenerQueue<T>::listen_for(T& element, std::chrono::milliseconds timeout){
 	std::unique_lock<std::mutex> lock(ThreadSafeListenerQueue<T>::mList);
-	if(cv.wait_for(lock, mil, [this]{return !(this->storage.empty());})){
-		element = ThreadSafeListenerQueue<T>::storage.back();
+	QueueStatus status = ThreadSafeListenerQueue<T>::waitForElement(lock, timeout);
+	if(status == QueueStatus::Ready){
+		element = std::move(ThreadSafeListenerQueue<T>::storage.back());
 		ThreadSafeListenerQueue<T>::storage.pop_back();
-		return true;
 	}
-	else{
-		return false;
+	return status;
+}
+
+/*
+Closes the queue: later pushes fail and every thread sleeping in a listen wakes up.
+*/
+template<class T>
+void ThreadSafeListenerQueue<T>::close(){
+	std::lock_guard<std::mutex> lock(ThreadSafeListenerQueue<T>::mList);
+	ThreadSafeListenerQueue<T>::isClosed = true;
+	ThreadSafeListenerQueue<T>::cv.notify_all();
+}
+
+template<class T>
+void ThreadSafeListenerQueue<T>::takeOldest(std::list<T>& taken, size_t max){
+	if(max >= ThreadSafeListenerQueue<T>::storage.size()){
+		taken.splice(taken.end(), ThreadSafeListenerQueue<T>::storage);
+		return;
+	}
+	//The oldest elements are at the back of storage
+	typename std::list<T>::iterator start = ThreadSafeListenerQueue<T>::storage.end();
+	std::advance(start, -(std::ptrdiff_t)max);
+	taken.splice(taken.end(), ThreadSafeListenerQueue<T>::storage, start, ThreadSafeListenerQueue<T>::storage.end());
+}
+
+template<class T>
+size_t ThreadSafeListenerQueue<T>::moveOut(std::list<T>& taken, std::vector<T>& out){
+	out.reserve(out.size() + taken.size());
+	for(typename std::list<T>::reverse_iterator it = taken.rbegin(); it != taken.rend(); ++it){
+		out.push_back(std::move(*it));
 	}
+	return taken.size();
+}
+
+/*
+Inserts every item in [first, last) with a single lock acquisition.
+@param first: the first item to be added
+@param last: one past the last item to be added
+@returns true when the items are successfully inserted, false if the queue has been closed
+*/
+template<class T>
+template<class InputIt>
+bool ThreadSafeListenerQueue<T>::push_batch(InputIt first, InputIt last){
+	//Build the nodes before taking the lock, newest at the front like storage, then link them in at once
+	std::list<T> nodes;
+	for(; first != last; ++first){
+		nodes.push_front(*first);
+	}
+	if(nodes.empty())return true;
+	std::lock_guard<std::mutex> lock(ThreadSafeListenerQueue<T>::mList);
+	if(ThreadSafeListenerQueue<T>::isClosed)return false;
+	ThreadSafeListenerQueue<T>::storage.splice(ThreadSafeListenerQueue<T>::storage.begin(), nodes);
+	ThreadSafeListenerQueue<T>::cv.notify_all();
+	return true;
+}
+
+/*
+Removes up to max of the oldest elements with a single lock acquisition and appends them to out.
+@param out: where the removed elements will be appended
+@param max: the most elements to remove
+@returns the number of elements removed
+*/
+template<class T>
+size_t ThreadSafeListenerQueue<T>::pop_batch(std::vector<T>& out, size_t max){
+	//The nodes are freed after the lock is released, when taken goes out of scope
+	std::list<T> taken;
+	{
+		std::lock_guard<std::mutex> lock(ThreadSafeListenerQueue<T>::mList);
+		ThreadSafeListenerQueue<T>::takeOldest(taken, max);
+	}
+	return ThreadSafeListenerQueue<T>::moveOut(taken, out);
+}
+
+/*
+Removes every element in the queue with a single lock acquisition and appends them to out.
+@param out: where the removed elements will be appended
+@returns the number of elements removed
+*/
+template<class T>
+size_t ThreadSafeListenerQueue<T>::drain(std::vector<T>& out){
+	return ThreadSafeListenerQueue<T>::pop_batch(out, SIZE_MAX);
+}
+
+/*
+Same as pop_batch, but waits until the queue has an element or is closed.
+@param out: where the removed elements will be appended
+@param max: the most elements to remove
+@returns Ready when at least one element is removed, Closed once the queue is closed and empty
+*/
+template<class T>
+QueueStatus ThreadSafeListenerQueue<T>::listen_batch(std::vector<T>& out, size_t max){
+	return ThreadSafeListenerQueue<T>::listen_batch_for(out, max, FOREVER);
+}
+
+/*
+Same as listen_batch, but gives up once timeout has passed.
+@param out: where the removed elements will be appended
+@param max: the most elements to remove
+@param timeout: how long to wait for the first element
+@returns Ready when at least one element is removed, Timeout if none arrived in time, Closed
+once the queue is closed and empty
+*/
+template<class T>
+QueueStatus ThreadSafeListenerQueue<T>::listen_batch_for(std::vector<T>& out, size_t max, std::chrono::milliseconds timeout){
+	std::list<T> taken;
+	QueueStatus status;
+	{
+		std::unique_lock<std::mutex> lock(ThreadSafeListenerQueue<T>::mList);
+		status = ThreadSafeListenerQueue<T>::waitForElement(lock, timeout);
+		if(status == QueueStatus::Ready)ThreadSafeListenerQueue<T>::takeOldest(taken, max);
+	}
+	ThreadSafeListenerQueue<T>::moveOut(taken, out);
+	return status;
+}
+
+/*
+A bounded, lock-free multi-producer/multi-consumer queue with the same push/pop/listen interface as
+ThreadSafeListenerQueue. Elements live in a fixed ring of cells allocated once up front, so nothing
+is allocated per push. Each cell carries a sequence number that tells producers and consumers whose
+turn it is (Dmitry Vyukov's bounded MPMC queue), and the two ends of the ring are claimed with a
+compare-and-swap on separate cache lines. Threads that find the queue full (push) or empty (listen)
+spin briefly and then sleep on a condition variable until the other side signals them.
+*/
+template<class T>
+class BoundedListenerQueue{
+	private:
+		struct Cell{
+			std::atomic<size_t> sequence;
+			T data;
+		};
+
+		//Tries before a blocked push/listen stops spinning and sleeps
+		static const int SPIN_LIMIT = 64;
+
+		std::unique_ptr<Cell[]> cells;
+		size_t mask;
+
+		//Each end of the ring gets its own cache line so producers and consumers do not false-share
+		char padHead[64];
+		std::atomic<size_t> enqueuePos;
+		char padMiddle[64];
+		std::atomic<size_t> dequeuePos;
+		char padTail[64];
+
+		//Sleeping is only for when spinning did not help; the fast paths never touch this mutex
+		std::mutex mPark;
+		std::condition_variable notEmpty;
+		std::condition_variable notFull;
+		std::atomic<int> waitingConsumers;
+		std::atomic<int> waitingProducers;
+
+		//Set once by close(); pushes fail and sleepers give up once they see it
+		std::atomic<bool> isClosed;
+
+		//Single attempts that return false instead of waiting when the queue is full/empty. The
+		//element is only copied/moved out of once a cell has been claimed.
+		template<class U>
+		bool tryPush(U&& element);
+		bool tryPop(T& element);
+
+		//Blocking push shared by the copy and move overloads
+		template<class U>
+		bool pushBlocking(U&& element);
+
+		//Claim a run of up to count consecutive cells with one compare-and-swap and fill/empty
+		//them. They return how many cells were claimed, 0 if the queue is full/empty.
+		template<class ForwardIt>
+		size_t tryPushBatch(ForwardIt& first, size_t count);
+		size_t tryPopBatch(std::vector<T>& out, size_t max);
+
+		//Wakes a sleeping consumer/producer, if there is one, after a successful push/pop
+		void signal(std::atomic<int>& waiting, std::condition_variable& cond);
+
+		//Calls attempt (a tryPop/tryPopBatch) until it takes something, spinning and then sleeping
+		//on notEmpty until the queue is closed or timeout passes. A timeout of FOREVER never expires.
+		static constexpr std::chrono::milliseconds FOREVER = std::chrono::milliseconds::max();
+		template<class Attempt>
+		QueueStatus consume(Attempt attempt, std::chrono::milliseconds timeout);
+	public:
+		/*
+		Creates an empty queue that holds up to capacity elements (rounded up to a power of two).
+
+		@param capacity: the most elements the queue can hold at once
+		*/
+		explicit BoundedListenerQueue(size_t capacity = 1024);
+
+		/*
+		Inserts an item at the back of the queue. If the queue is full, the thread waits until
+		there is room. Returns true if inserted successfully and false if the queue has been closed.
+
+		@param element: element to be added to the queue
+		@returns true when the item is successfully inserted.
+		*/
+		bool push(const T& element);
+
+		/*
+		Moves an item to the back of the queue instead of copying it. If the queue is full, the
+		thread waits until there is room. Returns true if inserted successfully and false if the
+		queue has been closed.
+
+		@param element: element to be moved into the queue
+		@returns true when the item is successfully inserted.
+		*/
+		bool push(T&& element);
+
+		/*
+		Constructs an item from args and moves it to the back of the queue. The cells of the ring
+		already hold constructed elements, so this is one construction plus one move assignment.
+
+		@param args: the arguments passed to T's constructor
+		@returns true when the item is successfully inserted, false if the queue has been closed
+		*/
+		template<class... Args>
+		bool emplace(Args&&... args);
+
+		/*
+		Removes the element that has been in the queue the longest and moves it into
+		the parameter element. Returns true if an element has been removed and false
+		if the list is empty.
+
+		@param element: where the removed element will be stored
+		@returns true if an element has been removed and false if the list is empty
+		*/
+		bool pop(T& element);
+
+		/*
+		Removes the element that has been in the queue the longest and moves it into
+		the parameter element. If the queue is empty, it puts the thread to sleep until
+		there is an element in the queue or the queue is closed.
+
+		@param element: where the removed element will be stored
+		@returns Ready when an element is removed, Closed once the queue is closed and empty
+		*/
+		QueueStatus listen(T& element);
+
+		/*
+		Same as listen, but gives up once timeout has passed.
+
+		@param element: where the removed element will be stored
+		@param timeout: how long to wait for an element
+		@returns Ready when an element is removed, Timeout if none arrived in time, Closed once
+		the queue is closed and empty
+		*/
+		QueueStatus listen_for(T& element, std::chrono::milliseconds timeout);
+
+		/*
+		Closes the queue: later pushes fail, and every thread sleeping in a push or listen wakes up.
+		Elements already in the queue can still be removed; listens return Closed once it is empty.
+		*/
+		void close();
+
+		/*
+		Inserts every item in [first, last), claiming as many free cells as possible with each
+		compare-and-swap. If the queue fills up, the thread waits until there is room for the rest.
+		Pass move iterators to move the items in.
+
+		@param first: the first item to be added
+		@param last: one past the last item to be added
+		@returns true when the items are successfully inserted, false if the queue was closed before
+		all of them were
+		*/
+		template<class ForwardIt>
+		bool push_batch(ForwardIt first, ForwardIt last);
+
+		/*
+		Removes up to max of the oldest elements, claiming them with a single compare-and-swap,
+		and appends them to out, oldest first. Does not wait if the queue is empty.
+
+		@param out: where the removed elements will be appended
+		@param max: the most elements to remove
+		@returns the number of elements removed
+		*/
+		size_t pop_batch(std::vector<T>& out, size_t max);
+
+		/*
+		Removes every element that is ready in the queue and appends them to out, oldest first.
+
+		@param out: where the removed elements will be appended
+		@returns the number of elements removed
+		*/
+		size_t drain(std::vector<T>& out);
+
+		/*
+		Same as pop_batch, but if the queue is empty, it puts the thread to sleep until there is
+		an element in the queue or the queue is closed.
+
+		@param out: where the removed elements will be appended
+		@param max: the most elements to remove
+		@returns Ready when at least one element is removed, Closed once the queue is closed and empty
+		*/
+		QueueStatus listen_batch(std::vector<T>& out, size_t max);
+
+		/*
+		Same as listen_batch, but gives up once timeout has passed.
+
+		@param out: where the removed elements will be appended
+		@param max: the most elements to remove
+		@param timeout: how long to wait for the first element
+		@returns Ready when at least one element is removed, Timeout if none arrived in time, Closed
+		once the queue is closed and empty
+		*/
+		QueueStatus listen_batch_for(std::vector<T>& out, size_t max, std::chrono::milliseconds timeout);
+};
+
+template<class T>
+BoundedListenerQueue<T>::BoundedListenerQueue(size_t capacity)
+	: enqueuePos(0), dequeuePos(0), waitingConsumers(0), waitingProducers(0), isClosed(false){
+	size_t size = 2;
+	while(size < capacity)size *= 2;
+	cells.reset(new Cell[size]);
+	mask = size - 1;
+	for(size_t i = 0; i < size; i++){
+		cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+template<class T>
+template<class U>
+bool BoundedListenerQueue<T>::tryPush(U&& element){
+	size_t pos = enqueuePos.load(std::memory_order_relaxed);
+	while(true){
+		Cell& cell = cells[pos & mask];
+		size_t seq = cell.sequence.load(std::memory_order_acquire);
+		//seq == pos: the cell is free for this lap; seq < pos: a consumer has not emptied it yet
+		intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+		if(diff == 0){
+			if(enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+				cell.data = std::forward<U>(element);
+				cell.sequence.store(pos + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if(diff < 0){
+			return false;
+		}
+		else{
+			pos = enqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+template<class T>
+bool BoundedListenerQueue<T>::tryPop(T& element){
+	size_t pos = dequeuePos.load(std::memory_order_relaxed);
+	while(true){
+		Cell& cell = cells[pos & mask];
+		size_t seq = cell.sequence.load(std::memory_order_acquire);
+		//seq == pos + 1: a producer has filled the cell; anything less means the queue is empty
+		intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+		if(diff == 0){
+			if(dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+				element = std::move(cell.data);
+				//Hand the cell to the producer one lap ahead
+				cell.sequence.store(pos + mask + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if(diff < 0){
+			return false;
+		}
+		else{
+			pos = dequeuePos.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+template<class T>
+template<class ForwardIt>
+size_t BoundedListenerQueue<T>::tryPushBatch(ForwardIt& first, size_t count){
+	size_t pos = enqueuePos.load(std::memory_order_relaxed);
+	while(true){
+		intptr_t diff = (intptr_t)cells[pos & mask].sequence.load(std::memory_order_acquire) - (intptr_t)pos;
+		if(diff < 0){
+			return 0;
+		}
+		else if(diff > 0){
+			pos = enqueuePos.load(std::memory_order_relaxed);
+			continue;
+		}
+		//The run ends at the first cell that is not free for this lap. Only the producer that moves
+		//enqueuePos past a free cell can fill it, so the run stays free until the CAS below.
+		size_t n = 1;
+		while(n < count && cells[(pos + n) & mask].sequence.load(std::memory_order_acquire) == pos + n){
+			n++;
+		}
+		if(enqueuePos.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)){
+			for(size_t i = 0; i < n; i++, ++first){
+				Cell& cell = cells[(pos + i) & mask];
+				cell.data = *first;
+				cell.sequence.store(pos + i + 1, std::memory_order_release);
+			}
+			return n;
+		}
+	}
+}
+
+template<class T>
+size_t BoundedListenerQueue<T>::tryPopBatch(std::vector<T>& out, size_t max){
+	size_t pos = dequeuePos.load(std::memory_order_relaxed);
+	while(true){
+		intptr_t diff = (intptr_t)cells[pos & mask].sequence.load(std::memory_order_acquire) - (intptr_t)(pos + 1);
+		if(diff < 0){
+			return 0;
+		}
+		else if(diff > 0){
+			pos = dequeuePos.load(std::memory_order_relaxed);
+			continue;
+		}
+		size_t n = 1;
+		while(n < max && cells[(pos + n) & mask].sequence.load(std::memory_order_acquire) == pos + n + 1){
+			n++;
+		}
+		//Grow out before claiming so the claimed cells are not held across an allocation
+		out.reserve(out.size() + n);
+		if(dequeuePos.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)){
+			for(size_t i = 0; i < n; i++){
+				Cell& cell = cells[(pos + i) & mask];
+				out.push_back(std::move(cell.data));
+				cell.sequence.store(pos + i + mask + 1, std::memory_order_release);
+			}
+			return n;
+		}
+	}
+}
+
+template<class T>
+void BoundedListenerQueue<T>::signal(std::atomic<int>& waiting, std::condition_variable& cond){
+	//Pairs with the fence a sleeper issues after announcing itself: either we see it waiting, or it
+	//sees the element we just moved and never sleeps
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if(waiting.load(std::memory_order_relaxed) > 0){
+		std::lock_guard<std::mutex> lock(mPark);
+		cond.notify_all();
+	}
+}
+
+template<class T>
+bool BoundedListenerQueue<T>::push(const T& element){
+	return pushBlocking(element);
+}
+
+template<class T>
+bool BoundedListenerQueue<T>::push(T&& element){
+	return pushBlocking(std::move(element));
+}
+
+template<class T>
+template<class... Args>
+bool BoundedListenerQueue<T>::emplace(Args&&... args){
+	return pushBlocking(T(std::forward<Args>(args)...));
+}
+
+template<class T>
+template<class U>
+bool BoundedListenerQueue<T>::pushBlocking(U&& element){
+	if(isClosed.load(std::memory_order_acquire))return false;
+	for(int i = 0; i < SPIN_LIMIT; i++){
+		if(tryPush(std::forward<U>(element))){
+			signal(waitingConsumers, notEmpty);
+			return true;
+		}
+		if(i >= SPIN_LIMIT / 2)std::this_thread::yield();
+	}
+	std::unique_lock<std::mutex> lock(mPark);
+	waitingProducers.fetch_add(1);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	bool pushed = true;
+	while(!tryPush(std::forward<U>(element))){
+		if(isClosed.load(std::memory_order_acquire)){
+			pushed = false;
+			break;
+		}
+		notFull.wait(lock);
+	}
+	waitingProducers.fetch_sub(1);
+	lock.unlock();
+	if(pushed)signal(waitingConsumers, notEmpty);
+	return pushed;
+}
+
+template<class T>
+bool BoundedListenerQueue<T>::pop(T& element){
+	if(!tryPop(element))return false;
+	signal(waitingProducers, notFull);
+	return true;
+}
+
+template<class T>
+constexpr std::chrono::milliseconds BoundedListenerQueue<T>::FOREVER;
+
+template<class T>
+template<class Attempt>
+QueueStatus BoundedListenerQueue<T>::consume(Attempt attempt, std::chrono::milliseconds timeout){
+	for(int i = 0; i < SPIN_LIMIT && !isClosed.load(std::memory_order_relaxed); i++){
+		if(attempt()){
+			signal(waitingProducers, notFull);
+			return QueueStatus::Ready;
+		}
+		if(i >= SPIN_LIMIT / 2)std::this_thread::yield();
+	}
+	std::chrono::steady_clock::time_point deadline;
+	if(timeout != FOREVER)deadline = std::chrono::steady_clock::now() + timeout;
+	std::unique_lock<std::mutex> lock(mPark);
+	waitingConsumers.fetch_add(1);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	QueueStatus status = QueueStatus::Ready;
+	while(!attempt()){
+		//close() publishes everything pushed before it, so one more attempt after seeing the flag
+		//hands out the last elements before reporting Closed
+		if(isClosed.load(std::memory_order_acquire)){
+			if(!attempt())status = QueueStatus::Closed;
+			break;
+		}
+		if(timeout == FOREVER){
+			notEmpty.wait(lock);
+		}
+		else if(notEmpty.wait_until(lock, deadline) == std::cv_status::timeout){
+			if(!attempt())status = QueueStatus::Timeout;
+			break;
+		}
+	}
+	waitingConsumers.fetch_sub(1);
+	lock.unlock();
+	if(status == QueueStatus::Ready)signal(waitingProducers, notFull);
+	return status;
+}
+
+template<class T>
+QueueStatus BoundedListenerQueue<T>::listen(T& element){
+	return listen_for(element, FOREVER);
+}
+
+template<class T>
+QueueStatus BoundedListenerQueue<T>::listen_for(T& element, std::chrono::milliseconds timeout){
+	return consume([this, &element]{return this->tryPop(element);}, timeout);
+}
+
+template<class T>
+void BoundedListenerQueue<T>::close(){
+	isClosed.store(true, std::memory_order_release);
+	//Taking mPark means a sleeper is either already waiting (and gets notified) or has not yet
+	//checked the flag (and will see it)
+	std::lock_guard<std::mutex> lock(mPark);
+	notEmpty.notify_all();
+	notFull.notify_all();
+}
+
+template<class T>
+template<class ForwardIt>
+bool BoundedListenerQueue<T>::push_batch(ForwardIt first, ForwardIt last){
+	size_t remaining = std::distance(first, last);
+	int spins = 0;
+	while(remaining > 0){
+		if(isClosed.load(std::memory_order_acquire))return false;
+		size_t pushed = tryPushBatch(first, remaining);
+		if(pushed == 0 && spins < SPIN_LIMIT){
+			if(spins++ >= SPIN_LIMIT / 2)std::this_thread::yield();
+			continue;
+		}
+		if(pushed == 0){
+			std::unique_lock<std::mutex> lock(mPark);
+			waitingProducers.fetch_add(1);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			while((pushed = tryPushBatch(first, remaining)) == 0 && !isClosed.load(std::memory_order_acquire)){
+				notFull.wait(lock);
+			}
+			waitingProducers.fetch_sub(1);
+			if(pushed == 0)return false;
+		}
+		remaining -= pushed;
+		spins = 0;
+		signal(waitingConsumers, notEmpty);
+	}
+	return true;
+}
+
+template<class T>
+size_t BoundedListenerQueue<T>::pop_batch(std::vector<T>& out, size_t max){
+	if(max == 0)return 0;
+	size_t popped = tryPopBatch(out, max);
+	if(popped > 0)signal(waitingProducers, notFull);
+	return popped;
+}
+
+template<class T>
+size_t BoundedListenerQueue<T>::drain(std::vector<T>& out){
+	return pop_batch(out, mask + 1);
+}
+
+template<class T>
+QueueStatus BoundedListenerQueue<T>::listen_batch(std::vector<T>& out, size_t max){
+	return listen_batch_for(out, max, FOREVER);
+}
+
+template<class T>
+QueueStatus BoundedListenerQueue<T>::listen_batch_for(std::vector<T>& out, size_t max, std::chrono::milliseconds timeout){
+	if(max == 0)return QueueStatus::Ready;
+	return consume([this, &out, max]{return this->tryPopBatch(out, max) > 0;}, timeout);
 }
 
 #endif
\ No newline at end of file
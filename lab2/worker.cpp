@@ -2,36 +2,9 @@
 #include <cmath>
 #include <vector>
 #include "ts_queue.h"
+#include "rng.h"
 #include <random>
-
-/*
-Function that calculates the fitness according to the process defined in the READ_ME file
-
-
-@param coefficients - the coefficents to be mutated
-@param INIT_POINTS - the intitial points that the polynomial is bounded to
-
-@return the calculated fitness of the set of coefficients.
-*/
-float Worker::fitness(std::vector<float> coefficients, const std::vector< std::pair<float, float> > INIT_POINTS){
-	//The calculated fitness (a sum of the difference of y's)
-	float fitness = 0;
-	//Loop through all the points
-	for(int i = 0; i < INIT_POINTS.size(); i++){
-		//The calculated Y
-		float calcY = 0;
-		//Loop to calculate the polynomial
-		//explicit cast of int x to float
-		float fX = INIT_POINTS[i].first;
-		for(int j = 0; j < coefficients.size(); j++){
-			calcY += coefficients[j] * std::pow(fX, j);
-		}
-		//compare the difference between the two y-values
-		fitness += std::abs(calcY - INIT_POINTS[i].second); 
-	}
-	return fitness;
-}
-
+#include <algorithm>
 
 /*
 Takes the current coefficent set and randomly modifies them. Modification is dependent on the current fitness of the
@@ -40,24 +13,23 @@ the coefficients and the degree of the polynomial.
 @param coefficients - the coefficents to be mutated
 @param random - the random value to be added/subtracted from the coefficient
 @param randInd - the random value that determines whether the random value is added, subtracted, or done nothing with
-@param INIT_POINTS - the intitial points that the polynomial is bounded to
+@param fitness - the fitness of coefficients
+@param rng - the calling thread's random stream, which picks the modification for each coefficient
 
 @return the newly modified coefficients
 */
-std::vector<float> Worker::mutate(std::vector<float> coefficients, float random, const std::pair<int, int> randInd, const std::vector< std::pair<float, float> > INIT_POINTS){
+std::vector<float> Worker::mutate(const std::vector<float>& coefficients, float random, const std::pair<int, int> randInd, float fitness, Rng& rng){
 	std::vector<float> mutated;
 	int coeffSize = coefficients.size();
 	mutated = coefficients;
-	std::random_device randy;
-	std::mt19937 engy(randy());
 	std::uniform_int_distribution<> distry(1, 5);
 	if(coeffSize == 0)return mutated;
-	if(Worker::fitness(coefficients, INIT_POINTS) < 2.5 && coeffSize > 3){
+	if(fitness < 2.5 && coeffSize > 3){
 		random = random / 10;
 	}
-	mutated[0] = Worker::mutOne(mutated[0], random, distry(engy));
+	mutated[0] = Worker::mutOne(mutated[0], random, distry(rng));
 	for(int i = 1; i < coeffSize; i++){
-		mutated[i] = Worker::mutOne(mutated[i], random/i, distry(engy));
+		mutated[i] = Worker::mutOne(mutated[i], random/i, distry(rng));
 	}
 	return mutated;
 }
@@ -90,51 +62,64 @@ float Worker::mutOne(float coeff, float random, int randInd){
 
 
 /*
-The main function for each worker thread. Takes the current best coefficient and and modifies it. Then, it returns that value
-to the driver thread for processing.
+The main function for each worker thread. Takes the current best coefficient and modifies it POPULATION times, scoring
+all the children in one batch. Then, it returns the best child with its fitness to the driver thread for processing.
 
 @param wQueue, dQueue - the worker and driver queues respectively where both threads put the modified/current best coefficients
 @param INIT_POINTS - the intitial points that the polynomial is bounded to
+@param workerId - this worker's index, recorded on every candidate it sends
+@param rng - this worker's own random stream
 */
-void Worker::work(ThreadSafeListenerQueue<std::vector<float>> * wQueue, ThreadSafeListenerQueue<std::vector<float>> * dQueue, const std::vector< std::pair<float, float> > * INIT_POINTS){
+void Worker::work(BoundedListenerQueue<Candidate> * wQueue, BoundedListenerQueue<Candidate> * dQueue, const std::vector< std::pair<float, float> > * INIT_POINTS, int workerId, Rng rng){
 	std::vector<float> randoms;
-	//Random generator for the points
-	std::random_device rand;
-	std::mt19937 eng(rand());
 	std::uniform_int_distribution<> distr(1, 100);
 
 	for(int i = 0; i < 100; i++){
-		float j = distr(eng);
-		float k = distr(eng);
+		float j = distr(rng);
+		float k = distr(rng);
 		randoms.push_back(j/k);
 	}
 
 	int counter = 0;
-	std::vector<float> coeffs;
-	coeffs.push_back(1);
+	Candidate parent;
 
-	std::vector< std::pair<float, float> > points = *INIT_POINTS;
+	//Each worker lays out its own copy of the points for the fitness kernel
+	FitnessEngine points(*INIT_POINTS);
 
-	std::random_device randomSwitch;
-	std::mt19937 engSwit(randomSwitch());
 	std::uniform_int_distribution<> distrSwit(0, 6);
 
-	while(coeffs.size() != 0){
-		if(wQueue->listen(coeffs)){
+	//The children of one round, coefficient-major (population[j*POPULATION + c] is coefficient j of child c)
+	std::vector<float> population;
+	float scores[POPULATION];
+
+	//Sleep until there are coefficients to mutate; the driver closes wQueue once the best fit is found
+	while(wQueue->listen(parent) == QueueStatus::Ready){
+		const std::vector<float>& coeffs = parent.coefficients;
+		int coeffSize = coeffs.size();
+		population.resize(coeffSize * POPULATION);
+		for(int c = 0; c < POPULATION; c++){
 			std::pair<int, int> switches;
-			switches.first = distrSwit(engSwit) / 2;
-			switches.second = distrSwit(engSwit);
-			coeffs = Worker::mutate(coeffs, randoms[counter], switches, points);
-			dQueue->push(coeffs);
-		}
-		else{
-			std::vector<float> temp;
-			for(int i = 0; i <= points.size(); i++){
-				temp.push_back(1.0);
+			switches.first = distrSwit(rng) / 2;
+			switches.second = distrSwit(rng);
+			std::vector<float> child = Worker::mutate(coeffs, randoms[counter], switches, parent.fitness, rng);
+			for(int j = 0; j < coeffSize; j++){
+				population[j * POPULATION + c] = child[j];
 			}
-			dQueue->push(temp);
+			if(++counter == 100)counter = 0;
+		}
+		points.fitnessBatch(population.data(), POPULATION, coeffSize, scores);
+
+		//Only the best child goes to the driver
+		int best = std::min_element(scores, scores + POPULATION) - scores;
+		Candidate candidate;
+		candidate.coefficients.resize(coeffSize);
+		for(int j = 0; j < coeffSize; j++){
+			candidate.coefficients[j] = population[j * POPULATION + best];
 		}
-		if(++counter == 100)counter = 0;
+		candidate.fitness = scores[best];
+		candidate.generation = parent.generation;
+		candidate.workerId = workerId;
+		dQueue->push(std::move(candidate));
 	}
 	return;
 }
\ No newline at end of file
@@ -1,21 +1,29 @@
 #ifndef WORKER_H_
 #define WORKER_H_
 #include "ts_queue.h"
+#include "fitness.h"
+#include "rng.h"
 #include <vector>
 
+/*
+A set of coefficients together with its fitness, so the thread that receives it does not evaluate it again.
+This is the message on both worker_queue and driver_queue.
+*/
+struct Candidate{
+	std::vector<float> coefficients;
+	//fitness of coefficients, computed once by the thread that made them
+	float fitness;
+	//the driver's reseed count when the seed this candidate descends from was made
+	int generation;
+	//the worker that produced the coefficients, -1 for seeds made by the driver
+	int workerId;
+};
+
 class Worker{
 	public:
-
-		/*
-		Function that calculates the fitness according to the process defined in the READ_ME file
-
-
-		@param coefficients - the coefficents to be mutated
-		@param INIT_POINTS - the intitial points that the polynomial is bounded to
-
-		@return the calculated fitness of the set of coefficients.
-		*/
-		static float fitness(std::vector<float> coefficients, const std::vector< std::pair<float, float> > INIT_POINTS);
+		//Children generated and scored per round of work; 16 fills one AVX-512 or two AVX2 registers in
+		//FitnessEngine::fitnessBatch
+		static const int POPULATION = 16;
 
 		/*
 		Takes the current coefficent set and randomly modifies them. Modification is dependent on the current fitness of the
@@ -24,11 +32,12 @@ class Worker{
 		@param coefficients - the coefficents to be mutated
 		@param random - the random value to be added/subtracted from the coefficient
 		@param randInd - the random value that determines whether the random value is added, subtracted, or done nothing with
-		@param INIT_POINTS - the intitial points that the polynomial is bounded to
+		@param fitness - the fitness of coefficients
+		@param rng - the calling thread's random stream, which picks the modification for each coefficient
 
 		@return the newly modified coefficients
 		*/
-		static std::vector<float> mutate(std::vector<float> coefficients, float random, const std::pair<int, int> randInd, const std::vector< std::pair<float, float> > INIT_POINTS);
+		static std::vector<float> mutate(const std::vector<float>& coefficients, float random, const std::pair<int, int> randInd, float fitness, Rng& rng);
 
 		/*
 		Function that takes a coefficient and performs random modification on it. Returns the modified coefficient.
@@ -42,13 +51,15 @@ class Worker{
 		static float mutOne(float coeff, float random, int randInd);
 
 		/*
-		The main function for each worker thread. Takes the current best coefficient and and modifies it. Then, it returns that value
-		to the driver thread for processing.
+		The main function for each worker thread. Takes the current best coefficient and modifies it POPULATION times, scoring
+		all the children in one batch. Then, it returns the best child with its fitness to the driver thread for processing.
 
 		@param wQueue, dQueue - the worker and driver queues respectively where both threads put the modified/current best coefficients
 		@param INIT_POINTS - the intitial points that the polynomial is bounded to
+		@param workerId - this worker's index, recorded on every candidate it sends
+		@param rng - this worker's own random stream
 		*/
-		static void work(ThreadSafeListenerQueue<std::vector<float>> * wQueue, ThreadSafeListenerQueue<std::vector<float>> * dQueue, const std::vector< std::pair<float, float> > * INIT_POINTS);
+		static void work(BoundedListenerQueue<Candidate> * wQueue, BoundedListenerQueue<Candidate> * dQueue, const std::vector< std::pair<float, float> > * INIT_POINTS, int workerId, Rng rng);
 };
 
 #endif
\ No newline at end of file
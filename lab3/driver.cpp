@@ -7,8 +7,9 @@
 #include <vector>
 #include "worker.h"
 #include "ts_queue.h"
+#include "rng.h"
 
-std::pair< std::pair<int, int>, std::vector<float>> Driver::solve(int testDeg, int numOfThreads){
+std::pair< std::pair<int, int>, std::vector<float>> Driver::solve(int testDeg, int numOfThreads, uint64_t seed, bool refine){
 
 	//The initial points to fit the polynomial to
 	std::vector< std::pair<float, float> > INIT_POINTS;
@@ -31,55 +32,14 @@ std::pair< std::pair<int, int>, std::vector<float>> Driver::solve(int testDeg, i
 	//array of worker threads
 	std::thread workerThreads[wThreadNum];
 
-	//Random generator for the points
-	std::random_device rand;
-	std::mt19937 eng(rand());
+	//The points come from the first stream, the driver's seeds from the second and each worker gets the next one
+	Rng master(seed);
+	INIT_POINTS = Driver::makePoints(DEGREE, xNotY, master.fork());
+	Rng eng = master.fork();
 	std::uniform_int_distribution<> distr(-5, 5);
 
-	/*
-	There cannot be a set of initial points in which two points share an x and two other points
-	share a y. This is because the only way to link them would be disjoint lines. To prove this,
-	try solving a quadratic polynomial by hand but starting with points (1,5), (1,2), (0,5).
-	If you first try with A + Bx + Cx^2 = y, you'll end up with two equations like:
-		A + B + C = 5 and A + B + C = 2
-	Then, try with A + By + Cy^2 = x and you'll get two equations like:
-		A + 5B + 25C = 1 and A + 5B + 25C = 0
-	As the coefficents are constants, you cannot have either of those pairs of equations. This means
-	those sets of points would be impossible to solve for and the program would be stuck in an infinite
-	loop.
-	*/
-	bool validPoints = false;
-	while(!validPoints){
-		std::vector< std::pair<float, float> > fresh;
-		INIT_POINTS = fresh;
-		//Generate the points that the polynomial will be bound to
-		for(int i = 0; i < DEGREE + 1; i++){
-			float x = distr(eng);
-			float y = distr(eng);
-			std::pair<float, float> point (x, y);
-			INIT_POINTS.push_back(point);
-		}
-		for(int i = 0; i < INIT_POINTS.size(); i++){
-			for(int j = i+1; j < INIT_POINTS.size(); j++){
-				if(INIT_POINTS[i].first == INIT_POINTS[j].first)xNotY = false;
-			}
-		}
-		if(xNotY)validPoints = true;
-		if(!xNotY){
-			for(int i = 0; i < INIT_POINTS.size(); i++){
-				float tempFirst = INIT_POINTS[i].first;
-				INIT_POINTS[i].first = INIT_POINTS[i].second;
-				INIT_POINTS[i].second = tempFirst;
-			}
-		}
-		bool yVal = true;
-		for(int i = 0; i < INIT_POINTS.size(); i++){
-			for(int j = i+1; j < INIT_POINTS.size(); j++){
-				if(INIT_POINTS[i].first == INIT_POINTS[j].first)yVal = false;
-			}
-		}
-		if(yVal)validPoints = true;
-	}
+	//Evaluates fitness against INIT_POINTS for the driver thread
+	FitnessEngine engine(INIT_POINTS);
 
 	//where the current best coefficients will be stored in driver thread
 	std::vector<float> coefficients;
@@ -102,9 +62,9 @@ std::pair< std::pair<int, int>, std::vector<float>> Driver::solve(int testDeg, i
 			if(i!=0)coef = coef/i;
 			seeds.push_back(coef);
 		}
-		worker_queue.push(seeds);
 		coefficients = seeds;
-		workerThreads[i] = std::thread(Worker::work, &worker_queue, &driver_queue, &test_queue, &INIT_POINTS);
+		worker_queue.push(std::move(seeds));
+		workerThreads[i] = std::thread(Worker::work, &worker_queue, &driver_queue, &test_queue, &INIT_POINTS, master.fork());
 	}
 
 	int totalIter = 0;
@@ -116,26 +76,28 @@ std::pair< std::pair<int, int>, std::vector<float>> Driver::solve(int testDeg, i
 	if(DEGREE > 2)cap = 20000*DEGREE;
 	if(DEGREE > 4)cap = 60000*DEGREE;
 
-	float currentFitness = Worker::fitness(coefficients, INIT_POINTS);
+	float currentFitness = engine.fitness(coefficients);
 	//Driver loop while worker threads are producing new coefficients
 	while(currentFitness > IDEAL_FIT){
 		//Get new coefficients w/computed fitness from queue
 		std::vector<float> newCoeffs;
-		if(driver_queue.listen(newCoeffs)){
+		if(driver_queue.listen(newCoeffs) == QueueStatus::Ready){
 			//compare the fitness of two coefficients
-			if(currentFitness > Worker::fitness(newCoeffs, INIT_POINTS)){
+			if(currentFitness > engine.fitness(newCoeffs)){
 				//if the newCoeffs has better fitness, replace the old one
-				worker_queue.push(newCoeffs);
-				coefficients = newCoeffs;
-				currentFitness = Worker::fitness(coefficients, INIT_POINTS);
+				coefficients = std::move(newCoeffs);
+				currentFitness = engine.fitness(coefficients);
+				//polish it before the workers see it
+				if(refine)currentFitness = Worker::refine(coefficients, currentFitness, INIT_POINTS, engine);
+				worker_queue.push(coefficients);
 				countBestFit++;
 			}
 			else if(iteration_count > cap){
 				//This is hit because the program has hit a wall
 				//Reseed with new starting coefficients
-				std::vector<float> bs;
-				while(worker_queue.pop(bs)){}
-				while(driver_queue.pop(bs)){}
+				std::vector< std::vector<float> > bs;
+				worker_queue.drain(bs);
+				driver_queue.drain(bs);
 				for(int j = 0; j <wThreadNum; j++){
 					std::vector<float> newSeeds;
 					for(int i = 0; i < DEGREE + 1; i++){
@@ -144,10 +106,10 @@ std::pair< std::pair<int, int>, std::vector<float>> Driver::solve(int testDeg, i
 						if(i!=0)coef = coef /i;
 						newSeeds.push_back(coef);
 					}
-					worker_queue.push(newSeeds);
 					coefficients = newSeeds;
+					worker_queue.push(std::move(newSeeds));
 				}
-				currentFitness = Worker::fitness(coefficients, INIT_POINTS);
+				currentFitness = engine.fitness(coefficients);
 				iteration_count = 0;
 			}
 			else{
@@ -158,11 +120,10 @@ std::pair< std::pair<int, int>, std::vector<float>> Driver::solve(int testDeg, i
 		}
 	}
 
-	//Make sure all the threads know the best fit has been found
-	for(int i = 0; i < 2*wThreadNum; i++){
-		std::vector<float> empty;
-		worker_queue.push(empty);
-	}
+	//Make sure all the threads know the best fit has been found: closing wakes every worker
+	//listening on worker_queue and any worker still pushing to driver_queue
+	worker_queue.close();
+	driver_queue.close();
 
 	//Work done -> join the threads
 	for(int i = 0; i < wThreadNum; i++){
@@ -231,5 +192,112 @@ std::pair< std::pair<int, int>, std::vector<float>> Driver::solve(int testDeg, i
 	std::pair<int, int> retPair (totalIter, countBestFit);
 	std::pair<std::pair<int, int>, std::vector<float>> allTests (retPair, guessTime);
 
+	return allTests;
+}
+
+std::vector< std::pair<float, float> > Driver::makePoints(int DEGREE, bool& xNotY, Rng eng){
+	std::vector< std::pair<float, float> > INIT_POINTS;
+	xNotY = true;
+
+	std::uniform_int_distribution<> distr(-5, 5);
+
+	/*
+	There cannot be a set of initial points in which two points share an x and two other points
+	share a y. This is because the only way to link them would be disjoint lines. To prove this,
+	try solving a quadratic polynomial by hand but starting with points (1,5), (1,2), (0,5).
+	If you first try with A + Bx + Cx^2 = y, you'll end up with two equations like:
+		A + B + C = 5 and A + B + C = 2
+	Then, try with A + By + Cy^2 = x and you'll get two equations like:
+		A + 5B + 25C = 1 and A + 5B + 25C = 0
+	As the coefficents are constants, you cannot have either of those pairs of equations. This means
+	those sets of points would be impossible to solve for and the program would be stuck in an infinite
+	loop.
+	*/
+	bool validPoints = false;
+	while(!validPoints){
+		std::vector< std::pair<float, float> > fresh;
+		INIT_POINTS = fresh;
+		//Generate the points that the polynomial will be bound to
+		for(int i = 0; i < DEGREE + 1; i++){
+			float x = distr(eng);
+			float y = distr(eng);
+			std::pair<float, float> point (x, y);
+			INIT_POINTS.push_back(point);
+		}
+		for(int i = 0; i < INIT_POINTS.size(); i++){
+			for(int j = i+1; j < INIT_POINTS.size(); j++){
+				if(INIT_POINTS[i].first == INIT_POINTS[j].first)xNotY = false;
+			}
+		}
+		if(xNotY)validPoints = true;
+		if(!xNotY){
+			for(int i = 0; i < INIT_POINTS.size(); i++){
+				float tempFirst = INIT_POINTS[i].first;
+				INIT_POINTS[i].first = INIT_POINTS[i].second;
+				INIT_POINTS[i].second = tempFirst;
+			}
+		}
+		bool yVal = true;
+		for(int i = 0; i < INIT_POINTS.size(); i++){
+			for(int j = i+1; j < INIT_POINTS.size(); j++){
+				if(INIT_POINTS[i].first == INIT_POINTS[j].first)yVal = false;
+			}
+		}
+		if(yVal)validPoints = true;
+	}
+	return INIT_POINTS;
+}
+
+std::pair< std::pair<int, int>, std::vector<float>> Driver::solveIslands(int testDeg, int numOfThreads, uint64_t seed, bool refine){
+
+	//the degree of the polynomial
+	int DEGREE = testDeg;
+
+	//ideal fit setting
+	float IDEAL_FIT = 1;
+
+	//Determines whether the polynomial is defined by x or y
+	bool xNotY = true;
+
+	//The points come from the first stream, as in solve, so both solvers get the same points for the same seed
+	Rng master(seed);
+
+	//The initial points to fit the polynomial to
+	std::vector< std::pair<float, float> > INIT_POINTS = Driver::makePoints(DEGREE, xNotY, master.fork());
+
+	//Same reseed cap as solve, counted per island
+	int cap = 30000;
+	if(DEGREE > 2)cap = 20000*DEGREE;
+	if(DEGREE > 4)cap = 60000*DEGREE;
+
+	//Each island gets the next stream
+
+	IslandShared shared(numOfThreads);
+	std::vector<IslandResult> results(numOfThreads);
+	std::vector<std::thread> islandThreads;
+	for(int i = 0; i < numOfThreads; i++){
+		islandThreads.push_back(std::thread(Worker::island, i, &shared, &INIT_POINTS, DEGREE, IDEAL_FIT, cap, &results[i], master.fork(), refine));
+	}
+
+	//The islands stop themselves once one of them reaches IDEAL_FIT
+	for(int i = 0; i < numOfThreads; i++){
+		islandThreads[i].join();
+	}
+
+	int totalIter = 0;
+	float min = -1;
+	float max = 0;
+	float sum = 0;
+	for(int i = 0; i < numOfThreads; i++){
+		totalIter += results[i].iterations;
+		sum += results[i].averageTime;
+		if(min > results[i].averageTime || min == -1)min = results[i].averageTime;
+		if(max < results[i].averageTime)max = results[i].averageTime;
+	}
+	std::vector<float> guessTime = {min, max, sum / numOfThreads};
+
+	std::pair<int, int> retPair (totalIter, shared.improvements.load());
+	std::pair<std::pair<int, int>, std::vector<float>> allTests (retPair, guessTime);
+
 	return allTests;
 }
\ No newline at end of file
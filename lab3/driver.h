@@ -1,11 +1,51 @@
 #ifndef DRIVER_H_
 #define DRIVER_H_
 #include "ts_queue.h"
+#include "rng.h"
+#include <cstdint>
 #include <vector>
 
 class Driver{
 public:
-	static std::pair<std::pair<int, int>, std::vector<float>> solve(int degree, int numOfThreads);
+	/*
+	Fits a polynomial with one driver thread and numOfThreads workers. Every random draw descends from seed,
+	so the same seed always gives the same points, and with one worker the same search.
+
+	@param degree - the degree of the polynomial
+	@param numOfThreads - the number of worker threads
+	@param seed - the master seed (see rng.h)
+	@param refine - whether each new best goes through Worker::refine before it is sent back to the workers
+
+	@return ((candidates the driver processed, improvements to the best), {min, max, average} guess time in milliseconds)
+	*/
+	static std::pair<std::pair<int, int>, std::vector<float>> solve(int degree, int numOfThreads, uint64_t seed, bool refine);
+
+	/*
+	Solves the same problem as solve without a driver thread. Each of the numOfThreads threads is an island
+	(see Worker::island) with its own population; islands pass their best coefficients around a ring of
+	lock-free mailboxes and stop once any of them reaches the ideal fit.
+
+	@param degree - the degree of the polynomial
+	@param numOfThreads - the number of islands
+	@param seed - the master seed; the same seed gives the same points as solve
+	@param refine - whether each new island best goes through Worker::refine
+
+	@return ((children evaluated by all islands, improvements to the global best),
+		{min, max, mean} of the islands' average time per iteration in milliseconds)
+	*/
+	static std::pair<std::pair<int, int>, std::vector<float>> solveIslands(int degree, int numOfThreads, uint64_t seed, bool refine);
+
+private:
+	/*
+	Generates degree + 1 random points a polynomial can be fitted to (see the comment in the definition).
+
+	@param degree - the degree of the polynomial
+	@param xNotY - set to false if the points had to be swapped so the polynomial is in y
+	@param eng - the stream the points are drawn from
+
+	@return the points
+	*/
+	static std::vector< std::pair<float, float> > makePoints(int degree, bool& xNotY, Rng eng);
 };
 
 #endif
\ No newline at end of file
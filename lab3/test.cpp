@@ -1,8 +1,73 @@
 #include "driver.h"
 #include "worker.h"
 #include "ts_queue.h"
+#include "rng.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+/*
+Runs solve (one driver thread) and solveIslands (no driver) runs times each at the given degree and
+thread count, and prints how many children each evaluated per second of wall time.
+
+@param degree - the degree of the polynomial
+@param threads - the number of worker threads / islands
+@param runs - how many solves to average over
+@param seeds - the master seed for each run; both solvers get the same seed, and so the same points, on run i
+@param refine - whether both solvers refine each new best (see Worker::refine)
+*/
+void scaling(int degree, int threads, int runs, const std::vector<uint64_t>& seeds, bool refine){
+	float iterations[2] = {0, 0};
+	float seconds[2] = {0, 0};
+	for(int mode = 0; mode < 2; mode++){
+		for(int i = 0; i < runs; i++){
+			auto start = std::chrono::high_resolution_clock::now();
+			std::pair<std::pair<int, int>, std::vector<float>> result;
+			if(mode == 0)result = Driver::solve(degree, threads, seeds[i], refine);
+			else result = Driver::solveIslands(degree, threads, seeds[i], refine);
+			auto end = std::chrono::high_resolution_clock::now();
+			iterations[mode] += (result.first).first;
+			seconds[mode] += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0f;
+		}
+	}
+	std::cout << "Thread Num: " << threads << std::endl;
+	std::cout << "Driver Iterations/Second: " << iterations[0] / seconds[0] << std::endl;
+	std::cout << "Islands Iterations/Second: " << iterations[1] / seconds[1] << std::endl;
+}
 
 int main(int argc, char ** argv ){
+	bool scalingRun = false;
+	//With --seed every solve gets the same seed (run i of scaling gets seed + i), so timings compare the same problems
+	bool seeded = false;
+	uint64_t seed = 0;
+	//--refine turns on the gradient refinement of each new best
+	bool refine = false;
+	for(int i = 1; i < argc; i++){
+		std::string argument = argv[i];
+		if(argument == "scaling")scalingRun = true;
+		else if(argument == "--refine")refine = true;
+		else if(argument == "--seed" && i + 1 < argc){
+			seed = std::stoull(argv[++i]);
+			seeded = true;
+		}
+	}
+
+	//./lab3 scaling compares the driver and island solvers instead of running the full test set
+	if(scalingRun){
+		const int RUNS = 5;
+		std::vector<uint64_t> seeds;
+		for(int i = 0; i < RUNS; i++){
+			seeds.push_back(seeded ? seed + i : Rng::randomSeed());
+		}
+		int maxThreads = std::thread::hardware_concurrency();
+		if(maxThreads < 4)maxThreads = 4;
+		for(int threads = 1; threads <= maxThreads; threads *= 2){
+			scaling(3, threads, RUNS, seeds, refine);
+		}
+		return 0;
+	}
+
 	float iteration = 0;
 	float bests = 0;
 	float min = -1;
@@ -16,7 +81,7 @@ int main(int argc, char ** argv ){
 		for(degree; degree < 5; degree++){
 			if(degree == 2){
 				for(int i = 0; i < 100; i++){
-					std::pair<std::pair<int, int>, std::vector<float>> result = Driver::solve(degree, threads);
+					std::pair<std::pair<int, int>, std::vector<float>> result = Driver::solve(degree, threads, seeded ? seed : Rng::randomSeed(), refine);
 					iteration += (result.first).first;
 					bests += (result.first).second;
 					average += (result.second)[2];
@@ -34,7 +99,7 @@ int main(int argc, char ** argv ){
 
 			if(degree == 3){
 				for(int i = 0; i < 5; i++){
-					std::pair<std::pair<int, int>, std::vector<float>> result = Driver::solve(degree, threads);
+					std::pair<std::pair<int, int>, std::vector<float>> result = Driver::solve(degree, threads, seeded ? seed : Rng::randomSeed(), refine);
 					iteration += (result.first).first;
 					bests += (result.first).second;
 					average += (result.second)[2];
@@ -51,7 +116,7 @@ int main(int argc, char ** argv ){
 			}
 			if(degree > 3){
 				for(int i = 0; i < 1; i++){
-					std::pair<std::pair<int, int>, std::vector<float>> result = Driver::solve(degree, threads);
+					std::pair<std::pair<int, int>, std::vector<float>> result = Driver::solve(degree, threads, seeded ? seed : Rng::randomSeed(), refine);
 					iteration += (result.first).first;
 					bests += (result.first).second;
 					average += (result.second)[2];
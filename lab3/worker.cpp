@@ -2,37 +2,10 @@
 #include <cmath>
 #include <vector>
 #include "ts_queue.h"
+#include "rng.h"
 #include <random>
 #include <chrono>
-
-/*
-Function that calculates the fitness according to the process defined in the READ_ME file
-
-
-@param coefficients - the coefficents to be mutated
-@param INIT_POINTS - the intitial points that the polynomial is bounded to
-
-@return the calculated fitness of the set of coefficients.
-*/
-float Worker::fitness(std::vector<float> coefficients, const std::vector< std::pair<float, float> > INIT_POINTS){
-	//The calculated fitness (a sum of the difference of y's)
-	float fitness = 0;
-	//Loop through all the points
-	for(int i = 0; i < INIT_POINTS.size(); i++){
-		//The calculated Y
-		float calcY = 0;
-		//Loop to calculate the polynomial
-		//explicit cast of int x to float
-		float fX = INIT_POINTS[i].first;
-		for(int j = 0; j < coefficients.size(); j++){
-			calcY += coefficients[j] * std::pow(fX, j);
-		}
-		//compare the difference between the two y-values
-		fitness += std::abs(calcY - INIT_POINTS[i].second); 
-	}
-	return fitness;
-}
-
+#include <algorithm>
 
 /*
 Takes the current coefficent set and randomly modifies them. Modification is dependent on the current fitness of the
@@ -41,20 +14,19 @@ the coefficients and the degree of the polynomial.
 @param coefficients - the coefficents to be mutated
 @param random - the random value to be added/subtracted from the coefficient
 @param randInd - the random value that determines whether the random value is added, subtracted, or done nothing with
-@param INIT_POINTS - the intitial points that the polynomial is bounded to
+@param points - the fitness engine for the intitial points that the polynomial is bounded to
+@param rng - the calling thread's random stream, which picks the modification for each coefficient
 
 @return the newly modified coefficients
 */
-std::vector<float> Worker::mutate(std::vector<float> coefficients, float random, const std::pair<int, int> randInd, const std::vector< std::pair<float, float> > INIT_POINTS){
+std::vector<float> Worker::mutate(const std::vector<float>& coefficients, float random, const std::pair<int, int> randInd, const FitnessEngine& points, Rng& rng){
 	std::vector<float> mutated;
 	int coeffSize = coefficients.size();
 	mutated = coefficients;
-	std::random_device randy;
-	std::mt19937 engy(randy());
 	std::uniform_int_distribution<> distry(1, 5);
 	if(coeffSize == 0)return mutated;
 	for(int i = 0; i < coeffSize; i++){
-		mutated[i] = Worker::mutOne(mutated[i], random, distry(engy));
+		mutated[i] = Worker::mutOne(mutated[i], random, distry(rng));
 	}
 	return mutated;
 }
@@ -88,6 +60,108 @@ float Worker::mutOne(float coeff, float random, int randInd){
 	return mutated;
 }
 
+/*
+Improves a new best set of coefficients in place with up to REFINE_STEPS Levenberg-Marquardt steps on the residuals
+polynomial(x) - y. The residuals are linear in the coefficients, so their Jacobian is the Vandermonde matrix of the x-values
+and each step solves (J^T J + lambda * diag(J^T J)) step = -J^T r. A step is kept only if it lowers the fitness (the sum of
+the absolute residuals); otherwise lambda grows tenfold, shortening the step toward gradient descent, and refinement stops
+once ten tries in a row fail.
+
+@param coefficients - the coefficients to refine
+@param fitness - their current fitness
+@param INIT_POINTS - the intitial points that the polynomial is bounded to
+@param points - the fitness engine for the same points
+
+@return the fitness of the refined coefficients, never worse than fitness
+*/
+float Worker::refine(std::vector<float>& coefficients, float fitness, const std::vector< std::pair<float, float> >& INIT_POINTS, const FitnessEngine& points){
+	int coeffSize = coefficients.size();
+	//J^T J, row-major, and J^T r, in double since J^T J squares the Vandermonde matrix's condition number
+	std::vector<double> jtj(coeffSize * coeffSize);
+	std::vector<double> jtr(coeffSize);
+	std::vector<double> system(coeffSize * (coeffSize + 1));
+	std::vector<double> powers(coeffSize);
+	std::vector<float> trial(coeffSize);
+	double lambda = 1e-3;
+	for(int step = 0; step < REFINE_STEPS && fitness > 0; step++){
+		std::fill(jtj.begin(), jtj.end(), 0);
+		std::fill(jtr.begin(), jtr.end(), 0);
+		for(size_t i = 0; i < INIT_POINTS.size(); i++){
+			double x = INIT_POINTS[i].first;
+			double residual = -INIT_POINTS[i].second;
+			double power = 1;
+			for(int j = 0; j < coeffSize; j++){
+				powers[j] = power;
+				residual += coefficients[j] * power;
+				power *= x;
+			}
+			for(int j = 0; j < coeffSize; j++){
+				jtr[j] += powers[j] * residual;
+				for(int k = 0; k < coeffSize; k++){
+					jtj[j * coeffSize + k] += powers[j] * powers[k];
+				}
+			}
+		}
+
+		bool improved = false;
+		for(int tries = 0; tries < 10 && !improved; tries++){
+			//Augmented matrix [J^T J + lambda * diag(J^T J) | -J^T r], solved by Gaussian elimination with partial pivoting
+			for(int j = 0; j < coeffSize; j++){
+				for(int k = 0; k < coeffSize; k++){
+					system[j * (coeffSize + 1) + k] = jtj[j * coeffSize + k];
+				}
+				system[j * (coeffSize + 1) + j] *= 1 + lambda;
+				system[j * (coeffSize + 1) + coeffSize] = -jtr[j];
+			}
+			bool singular = false;
+			for(int k = 0; k < coeffSize && !singular; k++){
+				int pivot = k;
+				for(int j = k + 1; j < coeffSize; j++){
+					if(std::abs(system[j * (coeffSize + 1) + k]) > std::abs(system[pivot * (coeffSize + 1) + k]))pivot = j;
+				}
+				if(system[pivot * (coeffSize + 1) + k] == 0){
+					singular = true;
+					break;
+				}
+				for(int c = 0; c <= coeffSize; c++){
+					std::swap(system[k * (coeffSize + 1) + c], system[pivot * (coeffSize + 1) + c]);
+				}
+				for(int j = k + 1; j < coeffSize; j++){
+					double factor = system[j * (coeffSize + 1) + k] / system[k * (coeffSize + 1) + k];
+					for(int c = k; c <= coeffSize; c++){
+						system[j * (coeffSize + 1) + c] -= factor * system[k * (coeffSize + 1) + c];
+					}
+				}
+			}
+			if(singular)break;
+			for(int k = coeffSize - 1; k >= 0; k--){
+				double sum = system[k * (coeffSize + 1) + coeffSize];
+				for(int c = k + 1; c < coeffSize; c++){
+					sum -= system[k * (coeffSize + 1) + c] * trial[c];
+				}
+				//trial holds the step until the loop below adds the coefficients to it
+				trial[k] = sum / system[k * (coeffSize + 1) + k];
+			}
+			for(int j = 0; j < coeffSize; j++){
+				trial[j] += coefficients[j];
+			}
+
+			float trialFitness = points.fitness(trial);
+			if(trialFitness < fitness){
+				coefficients.swap(trial);
+				fitness = trialFitness;
+				lambda /= 10;
+				improved = true;
+			}
+			else{
+				lambda *= 10;
+			}
+		}
+		if(!improved)break;
+	}
+	return fitness;
+}
+
 
 /*
 The main function for each worker thread. Takes the current best coefficient and and modifies it. Then, it returns that value
@@ -95,28 +169,24 @@ to the driver thread for processing.
 
 @param wQueue, dQueue - the worker and driver queues respectively where both threads put the modified/current best coefficients
 @param INIT_POINTS - the intitial points that the polynomial is bounded to
+@param rng - this worker's own random stream
 */
-std::vector<float> Worker::work(ThreadSafeListenerQueue<std::vector<float>> * wQueue, ThreadSafeListenerQueue<std::vector<float>> * dQueue, ThreadSafeListenerQueue<std::vector<float>> * tQueue,const std::vector< std::pair<float, float> > * INIT_POINTS){
+std::vector<float> Worker::work(ThreadSafeListenerQueue<std::vector<float>> * wQueue, ThreadSafeListenerQueue<std::vector<float>> * dQueue, ThreadSafeListenerQueue<std::vector<float>> * tQueue,const std::vector< std::pair<float, float> > * INIT_POINTS, Rng rng){
 	std::vector<float> randoms;
-	//Random generator for the points
-	std::random_device rand;
-	std::mt19937 eng(rand());
 	std::uniform_int_distribution<> distr(1, 100);
 
 	for(int i = 0; i < 500; i++){
-		float j = distr(eng);
-		float k = distr(eng);
+		float j = distr(rng);
+		float k = distr(rng);
 		randoms.push_back(j/k);
 	}
 
 	int counter = 0;
 	std::vector<float> coeffs;
-	coeffs.push_back(1);
 
-	std::vector< std::pair<float, float> > points = *INIT_POINTS;
+	//Each worker lays out its own copy of the points for the fitness kernel
+	FitnessEngine points(*INIT_POINTS);
 
-	std::random_device randomSwitch;
-	std::mt19937 engSwit(randomSwitch());
 	std::uniform_int_distribution<> distrSwit(0, 6);
 
 	int timerCount = 0;
@@ -124,34 +194,170 @@ std::vector<float> Worker::work(ThreadSafeListenerQueue<std::vector<float>> * wQ
 	int minTime = -1;
 	int sum = 0;
 
-	while(coeffs.size() != 0){
-		auto start_time = std::chrono::high_resolution_clock::now();
-		if(wQueue->listen(coeffs)){
-			std::pair<int, int> switches;
-			switches.first = distrSwit(engSwit) / 2;
-			switches.second = distrSwit(engSwit);
-			coeffs = Worker::mutate(coeffs, randoms[counter], switches, points);
-			dQueue->push(coeffs);
-			auto end_time = std::chrono::high_resolution_clock::now();
-			int milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(end_time-start_time).count();
-			sum += milliseconds;
-			if(maxTime < milliseconds)maxTime = milliseconds;
-			if(minTime > milliseconds || minTime == -1)minTime = milliseconds;
-			timerCount++;
-		}
-		else{
-			std::vector<float> temp;
-			for(int i = 0; i <= points.size(); i++){
-				temp.push_back(1.0);
-			}
-			dQueue->push(temp);
-		}
+	//Sleep until there are coefficients to mutate; the driver closes wQueue once the best fit is found
+	auto start_time = std::chrono::high_resolution_clock::now();
+	while(wQueue->listen(coeffs) == QueueStatus::Ready){
+		std::pair<int, int> switches;
+		switches.first = distrSwit(rng) / 2;
+		switches.second = distrSwit(rng);
+		dQueue->push(Worker::mutate(coeffs, randoms[counter], switches, points, rng));
+		auto end_time = std::chrono::high_resolution_clock::now();
+		int milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(end_time-start_time).count();
+		sum += milliseconds;
+		if(maxTime < milliseconds)maxTime = milliseconds;
+		if(minTime > milliseconds || minTime == -1)minTime = milliseconds;
+		timerCount++;
 		if(++counter == 100)counter = 0;
+		start_time = std::chrono::high_resolution_clock::now();
 	}
-	float average = sum/timerCount;
+	//A worker can be closed out before it ever gets coefficients
+	float average = 0;
+	if(timerCount > 0)average = sum/timerCount;
 	float min = minTime;
 	float max = maxTime;
 	std::vector<float> retTest = {min, max, average};
 	tQueue->push(retTest);
 	return retTest;
+}
+
+/*
+Lowers shared->bestFitness to fitness if it is an improvement, and raises the stop flag once it reaches idealFit.
+
+@param shared - the state shared by all islands
+@param fitness - the fitness an island just reached
+@param idealFit - the fitness at which the search stops
+*/
+static void publishFitness(IslandShared * shared, float fitness, float idealFit){
+	float seen = shared->bestFitness.load();
+	while(fitness < seen){
+		if(shared->bestFitness.compare_exchange_weak(seen, fitness)){
+			shared->improvements++;
+			break;
+		}
+	}
+	if(fitness <= idealFit)shared->done.store(true);
+}
+
+/*
+The main function for each island thread of Driver::solveIslands. The island keeps its own population and
+mutates one member per iteration, keeping the child if it beats that member. Every MIGRATE_EVERY iterations it
+sends a copy of its best member to the next island and takes in any migrant waiting in its own mailbox in place
+of its worst member. An island that goes cap iterations without improving reseeds its own population. It stops
+once any island has reached the ideal fit.
+
+@param id - this island's index into shared->mailboxes
+@param shared - the mailboxes, global best and stop flag shared by all islands
+@param INIT_POINTS - the intitial points that the polynomial is bounded to
+@param degree - the degree of the polynomial
+@param idealFit - the fitness at which the search stops
+@param cap - iterations without improvement before the island reseeds
+@param result - where the island leaves its best coefficients and counters
+@param rng - this island's own random stream
+@param refineBest - whether each new island best goes through refine before it is kept
+*/
+void Worker::island(int id, IslandShared * shared, const std::vector< std::pair<float, float> > * INIT_POINTS, int degree, float idealFit, int cap, IslandResult * result, Rng rng, bool refineBest){
+	std::vector<float> randoms;
+	std::uniform_int_distribution<> distr(1, 100);
+	std::uniform_int_distribution<> distrSeed(-5, 5);
+	std::uniform_int_distribution<> distrSwit(0, 6);
+
+	for(int i = 0; i < 500; i++){
+		float j = distr(rng);
+		float k = distr(rng);
+		randoms.push_back(j/k);
+	}
+
+	//Each island lays out its own copy of the points for the fitness kernel
+	FitnessEngine points(*INIT_POINTS);
+
+	int islands = shared->mailboxes.size();
+	Mailbox& inbox = shared->mailboxes[id];
+	Mailbox& neighbour = shared->mailboxes[(id + 1) % islands];
+
+	std::vector< std::vector<float> > population(ISLAND_POPULATION);
+	std::vector<float> scores(ISLAND_POPULATION);
+	int bestIndex = 0;
+
+	//Fills the population with new random coefficients, like the driver's reseed
+	auto reseed = [&](int scale){
+		for(int m = 0; m < ISLAND_POPULATION; m++){
+			population[m].clear();
+			for(int i = 0; i < degree + 1; i++){
+				//Prefer to explicitly cast
+				float coef = distrSeed(rng)*scale;
+				if(i!=0)coef = coef/i;
+				population[m].push_back(coef);
+			}
+			scores[m] = points.fitness(population[m]);
+			if(m == 0 || scores[m] < scores[bestIndex])bestIndex = m;
+		}
+	};
+
+	reseed(5);
+	result->coefficients = population[bestIndex];
+	result->fitness = scores[bestIndex];
+	publishFitness(shared, result->fitness, idealFit);
+
+	int counter = 0;
+	int iterations = 0;
+	int sinceImprovement = 0;
+	auto start_time = std::chrono::high_resolution_clock::now();
+	while(!shared->done.load(std::memory_order_relaxed)){
+		int m = iterations % ISLAND_POPULATION;
+		std::pair<int, int> switches;
+		switches.first = distrSwit(rng) / 2;
+		switches.second = distrSwit(rng);
+		std::vector<float> child = Worker::mutate(population[m], randoms[counter], switches, points, rng);
+		float childFitness = points.fitness(child);
+		//Keep the child if it beats its parent; the island's best only moves if it beats that too
+		bool improved = false;
+		if(childFitness < scores[m]){
+			population[m] = std::move(child);
+			scores[m] = childFitness;
+			if(m == bestIndex || scores[m] < scores[bestIndex]){
+				bestIndex = m;
+				improved = true;
+			}
+		}
+
+		if(improved){
+			sinceImprovement = 0;
+			if(refineBest)scores[m] = Worker::refine(population[m], scores[m], *INIT_POINTS, points);
+			if(scores[m] < result->fitness){
+				result->coefficients = population[m];
+				result->fitness = scores[m];
+				publishFitness(shared, scores[m], idealFit);
+			}
+		}
+		else if(++sinceImprovement > cap){
+			//This island has hit a wall; its best so far stays in result
+			reseed(15);
+			sinceImprovement = 0;
+		}
+
+		if(++iterations % MIGRATE_EVERY == 0){
+			//The neighbour may not have collected the last migrant yet; the newer one replaces it
+			delete neighbour.migrant.exchange(new std::vector<float>(population[bestIndex]));
+			std::vector<float> * migrant = inbox.migrant.exchange(nullptr);
+			if(migrant != nullptr){
+				float migrantFitness = points.fitness(*migrant);
+				int worst = 0;
+				for(int w = 1; w < ISLAND_POPULATION; w++){
+					if(scores[w] > scores[worst])worst = w;
+				}
+				if(migrantFitness < scores[worst]){
+					population[worst] = std::move(*migrant);
+					scores[worst] = migrantFitness;
+					if(migrantFitness < scores[bestIndex])bestIndex = worst;
+				}
+				delete migrant;
+			}
+		}
+		if(++counter == 100)counter = 0;
+	}
+	auto end_time = std::chrono::high_resolution_clock::now();
+	float milliseconds = std::chrono::duration_cast<std::chrono::microseconds>(end_time-start_time).count() / 1000.0f;
+	result->iterations = iterations;
+	result->averageTime = 0;
+	if(iterations > 0)result->averageTime = milliseconds / iterations;
 }
\ No newline at end of file
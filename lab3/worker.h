@@ -1,21 +1,67 @@
 #ifndef WORKER_H_
 #define WORKER_H_
 #include "ts_queue.h"
+#include "fitness.h"
+#include "rng.h"
 #include <vector>
+#include <atomic>
+#include <limits>
 
-class Worker{
-	public:
+/*
+One island's inbox for Driver::solveIslands. A neighbour swaps a new migrant in with an atomic exchange
+and the owner swaps it out the same way, so whoever takes the pointer out of the slot owns it.
+*/
+struct Mailbox{
+	//the latest migrant sent to this island, or nullptr
+	std::atomic<std::vector<float>*> migrant;
+	//keeps neighbouring mailboxes on separate cache lines
+	char pad[64 - sizeof(std::atomic<std::vector<float>*>)];
+};
 
-		/*
-		Function that calculates the fitness according to the process defined in the READ_ME file
+/*
+State shared by every island. None of it is behind a lock: islands only touch their own mailbox, their
+neighbour's mailbox and the atomics below.
+*/
+struct IslandShared{
+	//mailboxes[i] is island i's inbox; island i sends to mailboxes[(i + 1) % islands]
+	std::vector<Mailbox> mailboxes;
+	//the best fitness any island has found so far
+	std::atomic<float> bestFitness;
+	//set once bestFitness reaches the ideal fit; every island stops when it sees it
+	std::atomic<bool> done;
+	//how many times bestFitness improved
+	std::atomic<int> improvements;
 
+	explicit IslandShared(int islands) : mailboxes(islands), bestFitness(std::numeric_limits<float>::max()), done(false), improvements(0){
+		for(int i = 0; i < islands; i++){
+			mailboxes[i].migrant.store(nullptr);
+		}
+	}
 
-		@param coefficients - the coefficents to be mutated
-		@param INIT_POINTS - the intitial points that the polynomial is bounded to
+	//Migrants nobody collected before the islands stopped
+	~IslandShared(){
+		for(size_t i = 0; i < mailboxes.size(); i++){
+			delete mailboxes[i].migrant.load();
+		}
+	}
+};
 
-		@return the calculated fitness of the set of coefficients.
-		*/
-		static float fitness(std::vector<float> coefficients, const std::vector< std::pair<float, float> > INIT_POINTS);
+/*
+What an island hands back to Driver::solveIslands when it stops. Only the island writes it, and the
+driver only reads it after joining the island's thread.
+*/
+struct IslandResult{
+	//the best coefficients this island ever held and their fitness
+	std::vector<float> coefficients;
+	float fitness;
+	//how many children the island evaluated
+	int iterations;
+	//the island's average time per iteration in milliseconds
+	float averageTime;
+};
+
+class Worker{
+	public:
 
 		/*
 		Takes the current coefficent set and randomly modifies them. Modification is dependent on the current fitness of the
@@ -24,11 +70,12 @@ class Worker{
 		@param coefficients - the coefficents to be mutated
 		@param random - the random value to be added/subtracted from the coefficient
 		@param randInd - the random value that determines whether the random value is added, subtracted, or done nothing with
-		@param INIT_POINTS - the intitial points that the polynomial is bounded to
+		@param points - the fitness engine for the intitial points that the polynomial is bounded to
+		@param rng - the calling thread's random stream, which picks the modification for each coefficient
 
 		@return the newly modified coefficients
 		*/
-		static std::vector<float> mutate(std::vector<float> coefficients, float random, const std::pair<int, int> randInd, const std::vector< std::pair<float, float> > INIT_POINTS);
+		static std::vector<float> mutate(const std::vector<float>& coefficients, float random, const std::pair<int, int> randInd, const FitnessEngine& points, Rng& rng);
 
 		/*
 		Function that takes a coefficient and performs random modification on it. Returns the modified coefficient.
@@ -41,14 +88,55 @@ class Worker{
 		*/
 		static float mutOne(float coeff, float random, int randInd);
 
+		//Most Levenberg-Marquardt steps refine takes on one set of coefficients
+		static const int REFINE_STEPS = 8;
+
+		/*
+		Improves a new best set of coefficients in place with up to REFINE_STEPS Levenberg-Marquardt steps on the residuals
+		polynomial(x) - y, keeping a step only if it lowers the fitness (the sum of the absolute residuals).
+
+		@param coefficients - the coefficients to refine
+		@param fitness - their current fitness
+		@param INIT_POINTS - the intitial points that the polynomial is bounded to
+		@param points - the fitness engine for the same points
+
+		@return the fitness of the refined coefficients, never worse than fitness
+		*/
+		static float refine(std::vector<float>& coefficients, float fitness, const std::vector< std::pair<float, float> >& INIT_POINTS, const FitnessEngine& points);
+
 		/*
 		The main function for each worker thread. Takes the current best coefficient and and modifies it. Then, it returns that value
 		to the driver thread for processing.
 
 		@param wQueue, dQueue - the worker and driver queues respectively where both threads put the modified/current best coefficients
 		@param INIT_POINTS - the intitial points that the polynomial is bounded to
+		@param rng - this worker's own random stream
+		*/
+		static std::vector<float> work(ThreadSafeListenerQueue<std::vector<float>> * wQueue, ThreadSafeListenerQueue<std::vector<float>> * dQueue, ThreadSafeListenerQueue<std::vector<float> > * tQueue ,const std::vector< std::pair<float, float> > * INIT_POINTS, Rng rng);
+
+		//Members of each island's population
+		static const int ISLAND_POPULATION = 8;
+		//Iterations between sending the island's best to its neighbour and checking its own mailbox
+		static const int MIGRATE_EVERY = 256;
+
+		/*
+		The main function for each island thread of Driver::solveIslands. The island keeps its own population and
+		mutates one member per iteration, keeping the child if it beats that member. Every MIGRATE_EVERY iterations it
+		sends a copy of its best member to the next island and takes in any migrant waiting in its own mailbox in place
+		of its worst member. An island that goes cap iterations without improving reseeds its own population. It stops
+		once any island has reached the ideal fit.
+
+		@param id - this island's index into shared->mailboxes
+		@param shared - the mailboxes, global best and stop flag shared by all islands
+		@param INIT_POINTS - the intitial points that the polynomial is bounded to
+		@param degree - the degree of the polynomial
+		@param idealFit - the fitness at which the search stops
+		@param cap - iterations without improvement before the island reseeds
+		@param result - where the island leaves its best coefficients and counters
+		@param rng - this island's own random stream
+		@param refineBest - whether each new island best goes through refine before it is kept
 		*/
-		static std::vector<float> work(ThreadSafeListenerQueue<std::vector<float>> * wQueue, ThreadSafeListenerQueue<std::vector<float>> * dQueue, ThreadSafeListenerQueue<std::vector<float> > * tQueue ,const std::vector< std::pair<float, float> > * INIT_POINTS);
+		static void island(int id, IslandShared * shared, const std::vector< std::pair<float, float> > * INIT_POINTS, int degree, float idealFit, int cap, IslandResult * result, Rng rng, bool refineBest);
 };
 
 #endif
\ No newline at end of file
@@ -1,24 +1,48 @@
 #ifndef THREADSAFEMULTIMAP_H_
 #define THREADSAFEMULTIMAP_H_
 
-#include <map>
+#include <functional>
+#include <iterator>
 #include <utility>
 #include <pthread.h>
+#include <ext/pb_ds/assoc_container.hpp>
+#include <ext/pb_ds/tree_policy.hpp>
 
+/*
+A multimap kept sorted by key behind a reader-writer lock. It is built to be shared by every GA thread (pass it
+by pointer): many threads read random members at once while a few insert and evict. The lock prefers writers
+where the platform allows it, so a steady stream of readers cannot hold inserts off indefinitely.
+
+The elements live in an order-statistic tree (libstdc++'s policy-based red-black tree), which keeps the size of
+every subtree in its nodes, so finding the index-th element takes O(log n) instead of a walk from the start.
+The tree keys must be unique, so each key is stored with the insertion count: equal keys stay in insertion
+order, as they would in a std::multimap.
+*/
 template<class K, class V>
 class ThreadSafeMultimap{
 	protected:
-	//Internal hashmap used to store key-value pairs
-	std::multimap<K, V> map;
+	//The key as the tree sees it: (key, insertion number)
+	typedef std::pair<K, unsigned long> RankedKey;
+	typedef __gnu_pbds::tree<RankedKey, V, std::less<RankedKey>, __gnu_pbds::rb_tree_tag,
+		__gnu_pbds::tree_order_statistics_node_update> RankedTree;
+
+	//Internal tree used to store key-value pairs, sorted by key
+	RankedTree map;
+	//Insertions so far; written under the write lock
+	unsigned long inserted = 0;
+	//The most elements the map keeps, or 0 for no limit
+	const int capacity;
 	pthread_rwlock_t mutliMutex;
 	public:
 	/*
 	Inserts key-value pair into the map if the the value does not already exist.
 	If the key already exists in the map, the value is changed to the new value. Returns
-	true on successful insertion.
+	true on successful insertion. If the map has a capacity and is full, the element with
+	the highest key is evicted to make room, in O(log n); an element that would itself be
+	the highest is not inserted.
 
 	@param key, value: the key-value pair to be inserted
-	@return true when the key-value pair is inserted/updated
+	@return true when the key-value pair is inserted/updated, false if it did not make the cut
 	*/
 	bool insert(const K key, const V value);
 
@@ -50,6 +74,16 @@ class ThreadSafeMultimap{
 	*/
 	V operator [](int index);
 
+	/*
+	Reads two elements by index under a single read lock, so both come from the same version of the map.
+	Indices are clamped like operator[].
+
+	@param indA, indB - the indices of the elements to be read
+	@param a, b - where the elements are stored
+	@return false if the map is empty, in which case a and b are untouched
+	*/
+	bool sample(int indA, int indB, V& a, V& b);
+
 	/*
 	Reduces the size of the map to newSize. The highest value elements are cut off.
 
@@ -66,27 +100,84 @@ class ThreadSafeMultimap{
 
 	//Default constructor
 	ThreadSafeMultimap();
+
+	/*
+	Makes a map that only keeps the capacity elements with the lowest keys (the best K).
+
+	@param capacity - the most elements the map holds, or 0 for no limit
+	*/
+	explicit ThreadSafeMultimap(int capacity);
+
+	//Releases the lock
+	~ThreadSafeMultimap();
+
+	//Copying would copy the lock bit for bit and split the population in two, so it is not allowed
+	ThreadSafeMultimap(const ThreadSafeMultimap&) = delete;
+	ThreadSafeMultimap& operator=(const ThreadSafeMultimap&) = delete;
+
+	protected:
+	/*
+	Finds the index-th element in O(log n), clamping index to the first or last element. The caller holds
+	the lock.
+
+	@param index - the index of the element
+	@return an iterator to the element, or end() if the map is empty
+	*/
+	typename RankedTree::iterator at(int index);
 };
 
 //Default constructor
 template<class K, class V>
- ThreadSafeMultimap<K,V>::ThreadSafeMultimap(){
-		pthread_rwlock_init(&mutliMutex, NULL);
+ ThreadSafeMultimap<K,V>::ThreadSafeMultimap() : ThreadSafeMultimap(0){
+}
+
+/*
+Makes a map that only keeps the capacity elements with the lowest keys (the best K).
+
+@param capacity - the most elements the map holds, or 0 for no limit
+*/
+template<class K, class V>
+ ThreadSafeMultimap<K,V>::ThreadSafeMultimap(int capacity) : capacity(capacity){
+	pthread_rwlockattr_t attr;
+	pthread_rwlockattr_init(&attr);
+#ifdef __GLIBC__
+	//glibc lets readers starve writers by default
+	pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+	pthread_rwlock_init(&mutliMutex, &attr);
+	pthread_rwlockattr_destroy(&attr);
+}
+
+//Releases the lock
+template<class K, class V>
+ ThreadSafeMultimap<K,V>::~ThreadSafeMultimap(){
+	pthread_rwlock_destroy(&mutliMutex);
 }
 
 
 /*
 Inserts key-value pair into the map if the the value does not already exist.
 If the key already exists in the map, the value is changed to the new value. Returns
-true on successful insertion.
+true on successful insertion. If the map has a capacity and is full, the element with
+the highest key is evicted to make room, in O(log n); an element that would itself be
+the highest is not inserted.
 
 @param key, value: the key-value pair to be inserted
-@return true when the key-value pair is inserted/updated
+@return true when the key-value pair is inserted/updated, false if it did not make the cut
 */
 template<class K, class V>
 bool  ThreadSafeMultimap<K,V>::insert(const K key, const V value){
 	pthread_rwlock_wrlock(&mutliMutex);
-	map.insert(std::pair<K,V> (key, value));
+	if(capacity > 0 && (int)map.size() >= capacity){
+		auto worst = std::prev(map.end());
+		//Equal keys go after the ones already there, so a tie with the worst would be evicted at once
+		if(!(key < worst->first.first)){
+			pthread_rwlock_unlock(&mutliMutex);
+			return false;
+		}
+		map.erase(worst);
+	}
+	map.insert(std::make_pair(RankedKey(key, inserted++), value));
 	pthread_rwlock_unlock(&mutliMutex);
 	return true;
 }
@@ -102,8 +193,12 @@ associated value is stored in the value parameter.
 template<class K, class V>
 bool  ThreadSafeMultimap<K,V>::lookup(const K key, V& value){
 	pthread_rwlock_rdlock(&mutliMutex);
-	auto ele = map.find(key);
-	if(ele == map.end())return false;
+	//The first element with this key, if there is one
+	auto ele = map.lower_bound(RankedKey(key, 0));
+	if(ele == map.end() || ele->first.first != key){
+		pthread_rwlock_unlock(&mutliMutex);
+		return false;
+	}
 	value = ele->second;
 	pthread_rwlock_unlock(&mutliMutex);
 	return true;
@@ -120,14 +215,18 @@ Returns true assuming no errors/exceptions.
 template<class K, class V>
 bool  ThreadSafeMultimap<K,V>::remove(const K key){
 	pthread_rwlock_wrlock(&mutliMutex);
-	map.erase(key);
+	auto ele = map.lower_bound(RankedKey(key, 0));
+	while(ele != map.end() && ele->first.first == key){
+		map.erase(ele);
+		ele = map.lower_bound(RankedKey(key, 0));
+	}
 	pthread_rwlock_unlock(&mutliMutex);
 	return true;
 }
 
 /*
 Accesses the index-th element in the multimap. If the index is above the range, then the last
-element is returned. If it is below, then a null value is returned.
+element is returned, and if it is below, the first. If the map is empty, then a null value is returned.
 
 @param index - the index of the element to be accessed
 @return the associated value of the index
@@ -141,20 +240,47 @@ V  ThreadSafeMultimap<K,V>::operator [](int index){
 		pthread_rwlock_unlock(&mutliMutex);
 		return val;
 	}
-	if(index >= size){
-		val = map.rbegin()->second;
-	}
-	else{
-		auto it = map.begin();
-		for(int i = 0; i < index; i++){
-			++it;
-		}
-		val = it->second;
-	}
+	val = at(index)->second;
 	pthread_rwlock_unlock(&mutliMutex);
 	return val;
 }
 
+/*
+Reads two elements by index under a single read lock, so both come from the same version of the map.
+Indices are clamped like operator[].
+
+@param indA, indB - the indices of the elements to be read
+@param a, b - where the elements are stored
+@return false if the map is empty, in which case a and b are untouched
+*/
+template<class K, class V>
+bool  ThreadSafeMultimap<K,V>::sample(int indA, int indB, V& a, V& b){
+	pthread_rwlock_rdlock(&mutliMutex);
+	if(map.empty()){
+		pthread_rwlock_unlock(&mutliMutex);
+		return false;
+	}
+	a = at(indA)->second;
+	b = at(indB)->second;
+	pthread_rwlock_unlock(&mutliMutex);
+	return true;
+}
+
+/*
+Finds the index-th element in O(log n), clamping index to the first or last element. The caller holds
+the lock.
+
+@param index - the index of the element
+@return an iterator to the element, or end() if the map is empty
+*/
+template<class K, class V>
+typename ThreadSafeMultimap<K,V>::RankedTree::iterator  ThreadSafeMultimap<K,V>::at(int index){
+	if(map.empty())return map.end();
+	if(index >= (int)map.size())index = map.size() - 1;
+	if(index < 0)index = 0;
+	return map.find_by_order(index);
+}
+
 /*
 Reduces the size of the map to newSize. The highest value elements are cut off.
 
@@ -162,18 +288,11 @@ Reduces the size of the map to newSize. The highest value elements are cut off.
 */
 template<class K, class V>
 void  ThreadSafeMultimap<K,V>::truncate(int newSize){
-	std::multimap<K, V> newMap;
 	pthread_rwlock_wrlock(&mutliMutex);
-	if(map.size() < newSize){
-		pthread_rwlock_unlock(&mutliMutex);
-		return;
-	}
-	int count = 0;
-	for(auto it = map.begin(); it != map.end(); ++it){
-		if(count < newSize)newMap.insert(*it);
-		count++;
+	//Erase from the back in place; each erase is O(log n) and nothing is copied
+	while((int)map.size() > newSize && !map.empty()){
+		map.erase(std::prev(map.end()));
 	}
-	map = newMap;
 	pthread_rwlock_unlock(&mutliMutex);
 	return;
 }
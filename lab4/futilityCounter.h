@@ -1,17 +1,34 @@
 #ifndef FCOUNTER_H_
 #define FCOUNTER_H_
+#include <atomic>
 #include <mutex>
+#include <condition_variable>
 
-//A threadsafe counter that can be incremented up or zeroed
-class FutilityCounter{
+/*
+A threadsafe counter that can be incremented up or zeroed. The count is a lock-free atomic, so up() and zero() never
+block. The counter is aligned to its own cache line so mutators bumping it do not false-share with whatever is
+declared next to it. The mutex and condition variable are only touched the first time the count reaches the
+threshold, to wake the coordinator sleeping in wait().
+*/
+class alignas(64) FutilityCounter{
+	std::atomic<unsigned int> count;
+	//Flipped by the one up() that wakes wait()
+	std::atomic<bool> signalled;
 	std::mutex mtx;
-	unsigned int count;
+	std::condition_variable crossed;
+	bool reached;
 public:
 	//Specific to this lab -> counter holds the threshold
 	int threshold;
 
-	//increments the counter up by one
-	void up();
+	/*
+	Increments the counter up by one. The first call to bring the count to threshold or above wakes wait(); a
+	threshold of 0 is reached by the first call. Callers should compare the result with >= threshold, since other
+	threads may push it past.
+
+	@return the count after this increment
+	*/
+	unsigned int up();
 
 	//resets the counter to 0
 	void zero();
@@ -19,28 +36,41 @@ public:
 	//returns the current value of the counter
 	unsigned int get();
 
+	//blocks until the count has reached the threshold at least once
+	void wait();
+
 	//creates a FC with the threshold set to cap
 	FutilityCounter(int cap);
 };
 
 FutilityCounter::FutilityCounter(int cap){
 	count = 0;
+	signalled = false;
+	reached = false;
 	threshold = cap;
 }
 
-void FutilityCounter::up(){
-	std::lock_guard<std::mutex> lck(mtx);
-	count++;
+unsigned int FutilityCounter::up(){
+	unsigned int now = count.fetch_add(1, std::memory_order_relaxed) + 1;
+	if((long long)now >= threshold && !signalled.exchange(true)){
+		std::lock_guard<std::mutex> lck(mtx);
+		reached = true;
+		crossed.notify_all();
+	}
+	return now;
 }
 
 void FutilityCounter::zero(){
-	std::lock_guard<std::mutex> lck(mtx);
-	count = 0;
+	count.store(0, std::memory_order_relaxed);
 }
 
 unsigned int FutilityCounter::get(){
-	std::lock_guard<std::mutex> lck(mtx);
-	return count;
+	return count.load(std::memory_order_relaxed);
+}
+
+void FutilityCounter::wait(){
+	std::unique_lock<std::mutex> lck(mtx);
+	crossed.wait(lck, [this]{ return reached; });
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include "ga_solver.h"
+#include "ts_queue.h"
+#include "ThreadSafeMultimap.h"
+#include "futilityCounter.h"
+#include "rng.h"
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+static void Mixer(ThreadSafeMultimap<int, Genome> * population, ThreadSafeListenerQueue<Genome> * offspring, StopToken * stop, Rng rng){
+	//Distribution for choosing genomes to mix
+	std::uniform_int_distribution<> distr(0, population->size()-1);
+
+	//The length of the array of moves for each genome
+	int genomeSize = (*population)[0].moves.size();
+
+	//Altered distribution to avoid splicing at very beginning or end
+	std::uniform_int_distribution<> distrSp(1, genomeSize-2);
+
+	while(!stop->requested()){
+		//Get two random genomes from population
+		int indA = distr(rng);
+		int indB = distr(rng);
+		//Ensure they are two different genomes
+		while(indA == indB)indB = distr(rng);
+		Genome genA;
+		Genome genB;
+		population->sample(indA, indB, genA, genB);
+		
+		//Get the split point 
+		int spliceIndex = distrSp(rng);
+		Genome spliced = Genome(genomeSize);
+		for(int i = 0; i < spliceIndex; i++){
+			spliced.moves[i] = genA.moves[i];
+		}
+		for(int i = spliceIndex; i < genomeSize; i++){
+			spliced.moves[i] = genB.moves[i];
+		}
+		//a closed queue means the solve is over
+		if(!offspring->push(std::move(spliced)))return;
+	}
+}
+
+static void Mutator(ThreadSafeMultimap<int, Genome> * population, ThreadSafeListenerQueue<Genome> * offspring, FutilityCounter * futility, StopToken * stop, Maze * problem, long * iterations, Rng rng){
+	//Distribution for both moves and case probability
+	std::uniform_int_distribution<> distr(0, 4);
+
+	//The length of the array of moves for each genome
+	int genomeSize = (*population)[0].moves.size();
+
+	//Altered distribution to avoid splicing at very beginning or end
+	std::uniform_int_distribution<> distrSp(0, genomeSize-1);
+
+	//Counted locally and written once, so mutators do not share a counter
+	long count = 0;
+	while(!stop->requested()){
+		int fit = (*population)[0].fitness(problem);
+		Genome child (genomeSize);
+		if(offspring->listen(child) == QueueStatus::Closed)break;
+		//40% chance of further modification -> distr between 0-4
+		switch(distr(rng))
+		{
+			case 0:
+			case 1:
+				child.moves[distrSp(rng)] = distr(rng);
+				break;
+		}
+		//add new solution; the population is bounded, so the worst solution is evicted
+		population->insert(child.fitness(problem), child);
+		count++;
+		//update futility
+		if((*population)[0].fitness(problem) < fit)futility->zero();
+		//check if futility threshold is reached; solve() is woken to stop the other threads
+		else if((int)futility->up() >= futility->threshold)break;
+	}
+	*iterations = count;
+}
+
+GASolver::GASolver(int threadNum, int threshold, int genLength, Maze * problem, uint64_t seed){
+	this->threadNum = threadNum;
+	this->threshold = threshold;
+	this->genLength = genLength;
+	this->problem = problem;
+	this->seed = seed;
+}
+
+GAResult GASolver::solve(){
+	//One population shared by every thread, so what the mutators find reaches the mixers. It keeps the
+	//best 4*threadNum genomes, the size it starts with.
+	ThreadSafeMultimap<int, Genome> population(4*threadNum);
+
+	ThreadSafeListenerQueue<Genome> offspring;
+
+	FutilityCounter futility (threshold);
+
+	StopToken stop;
+
+	//Every random draw in the solve comes from streams forked from this generator
+	Rng master(seed);
+
+	//Distribution for generating genomes
+	std::uniform_int_distribution<> distr(0, 4);
+
+	//Start with random genomes
+	for(int i = 0; i < 4*threadNum; i++){
+		Genome gen (genLength);
+		for(int j = 0; j < genLength; j++){
+			gen.moves[j] = distr(master);
+		}
+		population.insert(gen.fitness(problem), gen);
+	}
+
+	//One slot per thread; only the mutators write theirs
+	std::vector<long> iterations(threadNum, 0);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<std::thread> threads;
+	for(int i = 0; i < threadNum; i++){
+		//Spawn with a 50/50 chance of either being a mixer or mutator
+		if(i%2==0){
+			threads.push_back(std::thread(Mutator, &population, &offspring, &futility, &stop, problem, &iterations[i], master.fork()));
+		}
+		else{
+			threads.push_back(std::thread(Mixer, &population, &offspring, &stop, master.fork()));
+		}
+	}
+
+	//Sleep until a mutator reports the futility threshold has been reached
+	futility.wait();
+	auto end = std::chrono::high_resolution_clock::now();
+
+	//Closing the queue wakes mutators blocked in listen() and makes every mixer's next push fail, so all of them
+	//see the stop promptly
+	stop.request();
+	offspring.close();
+	for(int i = 0; i < threadNum; i++){
+		threads[i].join();
+	}
+
+	GAResult result;
+	result.best = population[0];
+	result.fitness = result.best.fitness(problem);
+	result.finished = result.best.finish(problem);
+	result.iterations = 0;
+	for(int i = 0; i < threadNum; i++){
+		result.iterations += iterations[i];
+	}
+	result.seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+	result.offspringPerSecond = result.seconds > 0 ? result.iterations / result.seconds : 0;
+	return result;
+}
@@ -0,0 +1,74 @@
+#ifndef GA_SOLVER_H_
+#define GA_SOLVER_H_
+#include "genome.h"
+#include "maze.hpp"
+#include <atomic>
+#include <cstdint>
+
+/*
+A flag shared by every thread of one solve. The coordinator requests the stop once the futility threshold is reached,
+and mixers and mutators check it on every pass of their loop, so they all return on their own and can be joined.
+*/
+class StopToken{
+	std::atomic<bool> stopped;
+public:
+	StopToken() : stopped(false){}
+
+	//asks every thread holding this token to return
+	void request(){
+		stopped.store(true, std::memory_order_release);
+	}
+
+	//returns true once request() has been called
+	bool requested() const{
+		return stopped.load(std::memory_order_acquire);
+	}
+};
+
+//What one solve found, and how quickly
+struct GAResult{
+	//The best genome in the population when the search stopped
+	Genome best;
+	//Its fitness, and whether it ends on the maze's finish
+	int fitness;
+	bool finished;
+	//How many children the mutators scored and inserted, over every thread
+	long iterations;
+	//Wall time from the first thread starting to the futility threshold being reached
+	double seconds;
+	//iterations / seconds
+	double offspringPerSecond;
+};
+
+/*
+Runs the genetic search for a path through one maze: half the threads mix genomes from a shared population into
+children and the other half mutate those children and insert them back, until futility threshold children in a row
+fail to improve the best genome. Every call to solve() starts from a fresh population and joins all of its threads
+before returning, so a solver can be run over and over, e.g. in a benchmark loop.
+*/
+class GASolver{
+	int threadNum;
+	int threshold;
+	int genLength;
+	Maze * problem;
+	uint64_t seed;
+public:
+	/*
+	@param threadNum - the total number of threads, at least 2; even threads are mutators and odd ones mixers
+	@param threshold - how many children in a row may fail to improve the best genome before the search stops
+	@param genLength - the number of moves in each genome
+	@param problem - the maze to solve; it must outlive the solver
+	@param seed - every random draw of a solve (the starting population and each thread's stream) descends from it
+	*/
+	GASolver(int threadNum, int threshold, int genLength, Maze * problem, uint64_t seed);
+
+	/*
+	Builds a population of 4 * threadNum random genomes, runs the search until the futility threshold is reached,
+	then stops and joins every thread.
+
+	@return the best genome found and the statistics of the run
+	*/
+	GAResult solve();
+};
+
+#endif
@@ -7,8 +7,13 @@
 #include "maze.hpp"
 
 Maze::Maze(const size_t rows, const size_t cols)
+	: Maze(rows, cols, Rng::randomSeed())
+{}
+
+Maze::Maze(const size_t rows, const size_t cols, const uint64_t seed)
 	: rows_(rows)
 	, cols_(cols)
+	, rng_(seed)
 {
 	maze_.resize(cols_ * rows_);
 	generate();
@@ -57,7 +62,7 @@ void Maze::initialize() {
 void Maze::carve(const size_t x, const size_t y) {
 	static const int dirs[] = {1, -1, 0, 0};
 	reset(y, x);
-	const unsigned d = std::rand();
+	const unsigned d = rng_() >> 32;
 	for(unsigned i = 0; i < 4; i++) {
 		const int dx = dirs[(i + d + 0) % 4];
 		const int dy = dirs[(i + d + 2) % 4];
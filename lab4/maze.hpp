@@ -10,6 +10,8 @@
 #include <cmath>
 #include <iostream>
 #include <vector>
+#include <cstdint>
+#include "rng.h"
 
 struct Coord {
 	Coord(void)
@@ -34,6 +36,7 @@ class Maze {
 	const size_t rows_, cols_;
 	std::vector<bool> maze_;
 	Coord start_, finish_;
+	Rng rng_;								// Picks the carving directions
 	
   protected:
 	std::ostream& show(std::ostream &os) const;
@@ -41,6 +44,7 @@ class Maze {
 
   public:
 	Maze(const size_t rows, const size_t cols);
+	Maze(const size_t rows, const size_t cols, const uint64_t seed);	// Same seed, same maze
 	const bool get(const size_t row, const size_t col) const;		// Get whether there's a wall at the given (row, col)
 	const Coord getStart();
 	const Coord getFinish();
@@ -0,0 +1,96 @@
+#ifndef RNG_H_
+#define RNG_H_
+#include <cstdint>
+#include <random>
+
+/*
+A xoshiro256++ pseudo random number generator. The whole state is four 64-bit words, so making one
+is cheap, unlike std::mt19937 (about 5 KB of state) or std::random_device (a system call or an rdrand
+per draw). It meets the standard's UniformRandomBitGenerator requirements, so it can be handed to
+std::uniform_int_distribution and friends in place of std::mt19937.
+
+Each thread should own its own Rng. To hand them out, seed one master Rng and call fork() once per
+thread: every fork is 2^128 draws apart from the next, so the streams never overlap, and the same
+master seed always gives the same streams.
+*/
+class Rng{
+	private:
+		uint64_t state[4];
+
+		static uint64_t rotl(const uint64_t x, int k){
+			return (x << k) | (x >> (64 - k));
+		}
+
+	public:
+		typedef uint64_t result_type;
+
+		/*
+		Seeds the state from seed with SplitMix64, which spreads even small or similar seeds over the
+		whole state and never leaves it all zero.
+
+		@param seed - any 64-bit value
+		*/
+		explicit Rng(uint64_t seed){
+			for(int i = 0; i < 4; i++){
+				uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+				z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+				z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+				state[i] = z ^ (z >> 31);
+			}
+		}
+
+		static constexpr result_type min(){
+			return 0;
+		}
+
+		static constexpr result_type max(){
+			return UINT64_MAX;
+		}
+
+		//Returns the next 64 random bits
+		result_type operator()(){
+			const uint64_t result = rotl(state[0] + state[3], 23) + state[0];
+			const uint64_t t = state[1] << 17;
+			state[2] ^= state[0];
+			state[3] ^= state[1];
+			state[1] ^= state[2];
+			state[0] ^= state[3];
+			state[2] ^= t;
+			state[3] = rotl(state[3], 45);
+			return result;
+		}
+
+		//Advances the state by 2^128 draws
+		void jump(){
+			static const uint64_t JUMP[] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+			uint64_t s[4] = {0, 0, 0, 0};
+			for(int i = 0; i < 4; i++){
+				for(int b = 0; b < 64; b++){
+					if(JUMP[i] & (1ULL << b)){
+						for(int j = 0; j < 4; j++)s[j] ^= state[j];
+					}
+					(*this)();
+				}
+			}
+			for(int j = 0; j < 4; j++)state[j] = s[j];
+		}
+
+		/*
+		Splits off a stream for another thread.
+
+		@return a copy of this generator, after which this one jumps 2^128 draws ahead
+		*/
+		Rng fork(){
+			Rng stream = *this;
+			jump();
+			return stream;
+		}
+
+		//A seed for when the caller did not give one: 64 bits from std::random_device, read once
+		static uint64_t randomSeed(){
+			std::random_device device;
+			return ((uint64_t)device() << 32) ^ device();
+		}
+};
+
+#endif
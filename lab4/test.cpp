@@ -0,0 +1,101 @@
+#include "ga_solver.h"
+#include "maze.hpp"
+#include "rng.h"
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+Solves the same mazes runs times at the given thread count and prints the averages of each solve's statistics.
+
+@param threads - the total number of threads for each solve
+@param runs - how many solves to average over
+@param seeds - the seed for each run; run i always gets seeds[i], so every thread count solves the same mazes
+*/
+void scaling(int threads, int runs, const std::vector<uint64_t>& seeds){
+	const int ROWS = 12;
+	const int COLS = 12;
+	const int GEN_LENGTH = 48;
+	const int THRESHOLD = 2000;
+	double seconds = 0;
+	double iterations = 0;
+	double fitness = 0;
+	int finished = 0;
+	for(int i = 0; i < runs; i++){
+		Rng master(seeds[i]);
+		Maze problem (ROWS, COLS, master());
+		GASolver solver (threads, THRESHOLD, GEN_LENGTH, &problem, master());
+		GAResult result = solver.solve();
+		seconds += result.seconds;
+		iterations += result.iterations;
+		fitness += result.fitness;
+		if(result.finished)finished++;
+	}
+	std::cout << "Thread Num: " << threads << std::endl;
+	std::cout << "Average Time To Solution: " << seconds / runs << "s" << std::endl;
+	std::cout << "Offspring/Second: " << iterations / seconds << std::endl;
+	std::cout << "Average Fitness: " << fitness / runs << std::endl;
+	std::cout << "Reached Finish: " << finished << "/" << runs << std::endl;
+}
+
+/*
+Checks that solve() returns when the first up() of the futility counter already reaches the threshold (0 and 1),
+so the search stops after one child instead of waiting on a crossing that never comes. A solve that has not
+returned within a few seconds is reported and the program exits with status 1, since its threads cannot be joined.
+
+@param threads - the total number of threads for each solve
+@param seed - the seed for the maze and the solver
+@return true if every solve returned in time
+*/
+bool smallThresholds(int threads, uint64_t seed){
+	for(int threshold = 0; threshold <= 1; threshold++){
+		Rng master(seed);
+		Maze problem (8, 8, master());
+		GASolver solver (threads, threshold, 20, &problem, master());
+		std::future<GAResult> run = std::async(std::launch::async, &GASolver::solve, &solver);
+		if(run.wait_for(std::chrono::seconds(10)) != std::future_status::ready){
+			std::cout << "Threshold " << threshold << " with " << threads << " threads: solve() did not return" << std::endl;
+			std::cout.flush();
+			std::_Exit(1);
+		}
+		GAResult result = run.get();
+		if(result.iterations < 1)return false;
+	}
+	return true;
+}
+
+int main(int argc, char ** argv){
+	//With --seed run i gets seed + i, so timings from different builds compare the same mazes
+	bool seeded = false;
+	uint64_t seed = 0;
+	for(int i = 1; i < argc; i++){
+		std::string argument = argv[i];
+		if(argument == "--seed" && i + 1 < argc){
+			seed = std::stoull(argv[++i]);
+			seeded = true;
+		}
+	}
+
+	const int RUNS = 5;
+	std::vector<uint64_t> seeds;
+	for(int i = 0; i < RUNS; i++){
+		seeds.push_back(seeded ? seed + i : Rng::randomSeed());
+	}
+	int maxThreads = std::thread::hardware_concurrency();
+	if(maxThreads < 4)maxThreads = 4;
+	for(int threads = 2; threads <= maxThreads; threads *= 2){
+		if(!smallThresholds(threads, seeds[0])){
+			std::cout << "Threshold 0/1 with " << threads << " threads: no children were scored" << std::endl;
+			return 1;
+		}
+	}
+	std::cout << "Thresholds 0 and 1 stop every solve" << std::endl;
+	for(int threads = 2; threads <= maxThreads; threads *= 2){
+		scaling(threads, RUNS, seeds);
+	}
+	return 0;
+}